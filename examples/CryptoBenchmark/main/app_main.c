@@ -0,0 +1,977 @@
+// This example code is in the Public Domain (or CC0 licensed, at your option.)
+//
+// Unless required by applicable law or agreed to in writing, this
+// software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied.
+
+// Benchmarks the crypto primitives behind the ADK crypto API and the accessory side of pair-setup and pair-verify.
+//
+// Each result is printed to the console as one JSON object per line, e.g.
+//   {"benchmark":"x25519","backend":"optimized","bytes":0,"iterations":8,"cycles":1234567,"us":5144.029}
+// "cycles" and "us" are per iteration. "cycles" is null when the CPU has no cycle counter.
+//
+// Primitives that are replaced by the optimized implementations of the port (see the "Crypto" menu) are measured
+// twice: "optimized" through the ADK entry point and "mbedtls" through the original function. Transcripts use the
+// configured implementations only, so build once with and once without the optimizations to compare them end to end.
+
+#include <stdio.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "HAP.h"
+#include "HAPPlatform+Init.h"
+#include "HAPPlatformClock+Init.h"
+#include "HAPPlatformCrypto+Init.h"
+#include "HAPPlatformRandomNumber+Init.h"
+
+#if defined(__XTENSA__)
+#define HAVE_CYCLE_COUNTER 1
+#else
+#define HAVE_CYCLE_COUNTER 0
+#endif
+
+/**
+ * Original mbedTLS based functions of the ADK crypto API that the port replaces at link time with -Wl,--wrap.
+ */
+/**@{*/
+#if CONFIG_HAP_CRYPTO_CHACHA20_POLY1305
+void __real_HAP_chacha20_poly1305_encrypt_aad(
+        uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* c,
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+int __real_HAP_chacha20_poly1305_decrypt_aad(
+        const uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* m,
+        const uint8_t* c,
+        size_t c_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+#endif
+#if CONFIG_HAP_CRYPTO_SRP
+void __real_HAP_srp_public_key(
+        uint8_t pub_b[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]);
+int __real_HAP_srp_premaster_secret(
+        uint8_t s[SRP_PREMASTER_SECRET_BYTES],
+        const uint8_t pub_a[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t u[SRP_SCRAMBLING_PARAMETER_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]);
+#endif
+#if CONFIG_HAP_CRYPTO_CURVE25519
+void __real_HAP_X25519_scalarmult_base(uint8_t r[X25519_BYTES], const uint8_t n[X25519_SCALAR_BYTES]);
+void __real_HAP_X25519_scalarmult(
+        uint8_t r[X25519_BYTES],
+        const uint8_t n[X25519_SCALAR_BYTES],
+        const uint8_t p[X25519_BYTES]);
+void __real_HAP_ed25519_sign(
+        uint8_t sig[ED25519_BYTES],
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t sk[ED25519_SECRET_KEY_BYTES],
+        const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+int __real_HAP_ed25519_verify(
+        const uint8_t sig[ED25519_BYTES],
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+#endif
+#if CONFIG_HAP_CRYPTO_HKDF
+void __real_HAP_hkdf_sha512(
+        uint8_t* r,
+        size_t r_len,
+        const uint8_t* key,
+        size_t key_len,
+        const uint8_t* salt,
+        size_t salt_len,
+        const uint8_t* info,
+        size_t info_len);
+#endif
+/**@}*/
+
+/**
+ * Names of the implementations that the ADK entry points resolve to.
+ */
+/**@{*/
+#if CONFIG_HAP_CRYPTO_CHACHA20_POLY1305
+#define kChaCha20Poly1305Backend "optimized"
+#else
+#define kChaCha20Poly1305Backend "mbedtls"
+#endif
+#if CONFIG_HAP_CRYPTO_HKDF
+#define kHKDFBackend "optimized"
+#else
+#define kHKDFBackend "mbedtls"
+#endif
+#if CONFIG_HAP_CRYPTO_CURVE25519
+#define kCurve25519Backend "optimized"
+#else
+#define kCurve25519Backend "mbedtls"
+#endif
+#if CONFIG_HAP_CRYPTO_SRP
+#define kSRPBackend "optimized"
+#else
+#define kSRPBackend "mbedtls"
+#endif
+/**@}*/
+
+/**
+ * Message sizes for ChaCha20-Poly1305 and SHA-512. HAP-BLE fragments are small, HAP-IP frames are up to 1 KB.
+ */
+static const size_t kMessageSizes[] = { 16, 64, 256, 1024 };
+
+/**
+ * Iterations per measurement. Every loop runs one more iteration that is not counted: it warms up the caches and runs
+ * the known answer tests of the optimized implementations.
+ */
+/**@{*/
+#define kNumSymmetricIterations ((size_t) 64)
+#define kNumCurve25519Iterations ((size_t) 8)
+#define kNumSRPIterations ((size_t) 2)
+#define kNumPairSetupIterations ((size_t) 2)
+#define kNumPairVerifyIterations ((size_t) 8)
+#define kNumClockReads ((size_t) 1024)
+/**@}*/
+
+/**
+ * Accumulated cost of a measured operation.
+ *
+ * - The first run warms up caches and is not counted. One-off operations whose cold cost is of interest are
+ *   initialized with isWarmedUp set, so that their single run is counted.
+ */
+typedef struct {
+    bool isWarmedUp;
+    size_t numIterations;
+    uint64_t numCycles;
+    uint64_t duration;
+
+    uint64_t startTime;
+    uint32_t startCycles;
+} Measurement;
+
+#if HAVE_CYCLE_COUNTER
+/**
+ * Reads the CPU cycle counter. Only differences of less than 2^32 cycles are meaningful.
+ */
+HAP_RESULT_USE_CHECK
+static uint32_t GetCycleCount(void) {
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+}
+#endif
+
+static void MeasurementStart(Measurement* measurement) {
+    HAPPrecondition(measurement);
+
+    measurement->startTime = HAPPlatformClockGetCurrentMicroseconds();
+#if HAVE_CYCLE_COUNTER
+    measurement->startCycles = GetCycleCount();
+#endif
+}
+
+static void MeasurementStop(Measurement* measurement) {
+    HAPPrecondition(measurement);
+
+#if HAVE_CYCLE_COUNTER
+    uint32_t numCycles = GetCycleCount() - measurement->startCycles;
+#else
+    uint32_t numCycles = 0;
+#endif
+    uint64_t duration = HAPPlatformClockGetCurrentMicroseconds() - measurement->startTime;
+    if (!measurement->isWarmedUp) {
+        measurement->isWarmedUp = true;
+        return;
+    }
+    measurement->numCycles += numCycles;
+    measurement->duration += duration;
+    measurement->numIterations++;
+}
+
+/**
+ * Prints the cost per iteration of a measurement as one JSON line.
+ *
+ * @param      benchmark            Name of the benchmark.
+ * @param      backend              Name of the implementation.
+ * @param      numBytes             Number of bytes processed per iteration, or 0.
+ * @param      measurement          Measurement.
+ */
+static void Report(const char* benchmark, const char* backend, size_t numBytes, const Measurement* measurement) {
+    HAPPrecondition(benchmark);
+    HAPPrecondition(backend);
+    HAPPrecondition(measurement);
+    HAPPrecondition(measurement->numIterations);
+
+    uint64_t nanoseconds = measurement->duration * 1000 / measurement->numIterations;
+    char cycles[24] = "null";
+#if HAVE_CYCLE_COUNTER
+    snprintf(cycles, sizeof cycles, "%llu", (unsigned long long) (measurement->numCycles / measurement->numIterations));
+#endif
+    printf("{\"benchmark\":\"%s\",\"backend\":\"%s\",\"bytes\":%zu,\"iterations\":%zu,"
+           "\"cycles\":%s,\"us\":%llu.%03u}\n",
+           benchmark,
+           backend,
+           numBytes,
+           measurement->numIterations,
+           cycles,
+           (unsigned long long) (nanoseconds / 1000),
+           (unsigned) (nanoseconds % 1000));
+    fflush(stdout);
+}
+
+/**
+ * Aborts the benchmark if a result is wrong.
+ */
+static void Check(bool condition, const char* what) {
+    if (!condition) {
+        HAPLogError(&kHAPLog_Default, "%s failed.", what);
+        HAPFatalError();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+typedef void (*EncryptFunction)(
+        uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* c,
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+
+typedef int (*DecryptFunction)(
+        const uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* m,
+        const uint8_t* c,
+        size_t c_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+
+static void BenchmarkChaCha20Poly1305(const char* backend, EncryptFunction encrypt, DecryptFunction decrypt) {
+    static uint8_t frame[1024];
+    uint8_t key[CHACHA20_POLY1305_KEY_BYTES];
+    uint8_t nonce[8];
+    uint8_t aad[2];
+    uint8_t tag[CHACHA20_POLY1305_TAG_BYTES];
+    HAPPlatformRandomNumberFill(key, sizeof key);
+    HAPPlatformRandomNumberFill(frame, sizeof frame);
+    HAPRawBufferZero(nonce, sizeof nonce);
+
+    for (size_t i = 0; i < HAPArrayCount(kMessageSizes); i++) {
+        size_t numBytes = kMessageSizes[i];
+        HAPAssert(numBytes <= sizeof frame);
+        HAPWriteLittleUInt16(aad, numBytes);
+
+        Measurement encryption = { 0 };
+        Measurement decryption = { 0 };
+        for (size_t j = 0; j <= kNumSymmetricIterations; j++) {
+            HAPWriteLittleUInt64(nonce, j);
+            MeasurementStart(&encryption);
+            encrypt(tag, frame, frame, numBytes, aad, sizeof aad, nonce, sizeof nonce, key);
+            MeasurementStop(&encryption);
+            MeasurementStart(&decryption);
+            int e = decrypt(tag, frame, frame, numBytes, aad, sizeof aad, nonce, sizeof nonce, key);
+            MeasurementStop(&decryption);
+            Check(e == 0, "ChaCha20-Poly1305 decryption");
+        }
+        Report("chacha20-poly1305-encrypt", backend, numBytes, &encryption);
+        Report("chacha20-poly1305-decrypt", backend, numBytes, &decryption);
+    }
+}
+
+/**
+ * Measures HAPPlatformClockGetCurrent. The calls are timed as one batch because a single call is shorter than the
+ * measurement overhead.
+ */
+static void BenchmarkClock(void) {
+    Measurement measurement = { 0 };
+    for (size_t i = 0; i < 2; i++) {
+        HAPTime now = 0;
+        MeasurementStart(&measurement);
+        for (size_t j = 0; j < kNumClockReads; j++) {
+            HAPTime time = HAPPlatformClockGetCurrent();
+            Check(time >= now, "Monotonic clock");
+            now = time;
+        }
+        MeasurementStop(&measurement);
+    }
+    measurement.numIterations = kNumClockReads;
+    Report("clock-get-current", "platform", 0, &measurement);
+}
+
+static void BenchmarkSHA512(void) {
+    static uint8_t message[1024];
+    uint8_t md[SHA512_BYTES];
+    HAPPlatformRandomNumberFill(message, sizeof message);
+
+    for (size_t i = 0; i < HAPArrayCount(kMessageSizes); i++) {
+        size_t numBytes = kMessageSizes[i];
+        HAPAssert(numBytes <= sizeof message);
+
+        Measurement measurement = { 0 };
+        for (size_t j = 0; j <= kNumSymmetricIterations; j++) {
+            MeasurementStart(&measurement);
+            HAP_sha512(md, message, numBytes);
+            MeasurementStop(&measurement);
+        }
+        Report("sha512", "mbedtls", numBytes, &measurement);
+    }
+}
+
+typedef void (*HKDFFunction)(
+        uint8_t* r,
+        size_t r_len,
+        const uint8_t* key,
+        size_t key_len,
+        const uint8_t* salt,
+        size_t salt_len,
+        const uint8_t* info,
+        size_t info_len);
+
+/**
+ * Measures a pair-verify style session key derivation (32-byte key, salt and info strings, 32-byte output).
+ */
+static void BenchmarkHKDF(const char* backend, HKDFFunction hkdf) {
+    static const char salt[] = "Control-Salt";
+    static const char info[] = "Control-Read-Encryption-Key";
+    uint8_t key[X25519_BYTES];
+    uint8_t r[CHACHA20_POLY1305_KEY_BYTES];
+    HAPPlatformRandomNumberFill(key, sizeof key);
+
+    Measurement measurement = { 0 };
+    for (size_t i = 0; i <= kNumSymmetricIterations; i++) {
+        MeasurementStart(&measurement);
+        hkdf(r,
+             sizeof r,
+             key,
+             sizeof key,
+             (const uint8_t*) salt,
+             sizeof salt - 1,
+             (const uint8_t*) info,
+             sizeof info - 1);
+        MeasurementStop(&measurement);
+    }
+    Report("hkdf-sha512", backend, sizeof r, &measurement);
+}
+
+/**
+ * X25519 and Ed25519 functions of one implementation.
+ */
+typedef struct {
+    const char* backend;
+    void (*scalarmultBase)(uint8_t r[X25519_BYTES], const uint8_t n[X25519_SCALAR_BYTES]);
+    void (*scalarmult)(uint8_t r[X25519_BYTES], const uint8_t n[X25519_SCALAR_BYTES], const uint8_t p[X25519_BYTES]);
+    void (*sign)(
+            uint8_t sig[ED25519_BYTES],
+            const uint8_t* m,
+            size_t m_len,
+            const uint8_t sk[ED25519_SECRET_KEY_BYTES],
+            const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+    int (*verify)(
+            const uint8_t sig[ED25519_BYTES],
+            const uint8_t* m,
+            size_t m_len,
+            const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+} Curve25519Implementation;
+
+static void BenchmarkCurve25519(const Curve25519Implementation* implementation) {
+    HAPPrecondition(implementation);
+
+    uint8_t n[X25519_SCALAR_BYTES];
+    uint8_t p[X25519_BYTES];
+    uint8_t r[X25519_BYTES];
+    uint8_t sk[ED25519_SECRET_KEY_BYTES];
+    uint8_t pk[ED25519_PUBLIC_KEY_BYTES];
+    uint8_t sig[ED25519_BYTES];
+    // Size of the signed accessory info in pair-verify.
+    uint8_t m[2 * X25519_BYTES + 17];
+    HAPPlatformRandomNumberFill(sk, sizeof sk);
+    HAPPlatformRandomNumberFill(m, sizeof m);
+    HAP_ed25519_public_key(pk, sk);
+
+    Measurement scalarmultBase = { 0 };
+    Measurement scalarmult = { 0 };
+    Measurement sign = { 0 };
+    Measurement verify = { 0 };
+    for (size_t i = 0; i <= kNumCurve25519Iterations; i++) {
+        HAPPlatformRandomNumberFill(n, sizeof n);
+        HAPPlatformRandomNumberFill(p, sizeof p);
+        p[X25519_BYTES - 1] &= 0x7F;
+        MeasurementStart(&scalarmultBase);
+        implementation->scalarmultBase(r, n);
+        MeasurementStop(&scalarmultBase);
+        MeasurementStart(&scalarmult);
+        implementation->scalarmult(r, n, p);
+        MeasurementStop(&scalarmult);
+
+        m[0] = (uint8_t) i;
+        MeasurementStart(&sign);
+        implementation->sign(sig, m, sizeof m, sk, pk);
+        MeasurementStop(&sign);
+        MeasurementStart(&verify);
+        int e = implementation->verify(sig, m, sizeof m, pk);
+        MeasurementStop(&verify);
+        Check(e == 0, "Ed25519 verification");
+    }
+    Report("x25519-base", implementation->backend, 0, &scalarmultBase);
+    Report("x25519", implementation->backend, 0, &scalarmult);
+    Report("ed25519-sign", implementation->backend, sizeof m, &sign);
+    Report("ed25519-verify", implementation->backend, sizeof m, &verify);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * SRP user name of pair-setup.
+ */
+static const uint8_t kSRPUser[] = { 'P', 'a', 'i', 'r', '-', 'S', 'e', 't', 'u', 'p' };
+
+/**
+ * Setup code that the SRP verifier is derived from.
+ */
+static const uint8_t kSetupCode[] = { '1', '1', '1', '-', '2', '2', '-', '3', '3', '3' };
+
+/**
+ * SRP state of the benchmark. Large, so it is not kept on the stack.
+ */
+static struct {
+    uint8_t salt[SRP_SALT_BYTES];
+    uint8_t v[SRP_VERIFIER_BYTES];
+    uint8_t pub_a[SRP_PUBLIC_KEY_BYTES];
+    uint8_t pub_b[SRP_PUBLIC_KEY_BYTES];
+    uint8_t priv_b[SRP_SECRET_KEY_BYTES];
+    uint8_t u[SRP_SCRAMBLING_PARAMETER_BYTES];
+    uint8_t s[SRP_PREMASTER_SECRET_BYTES];
+    uint8_t k[SRP_SESSION_KEY_BYTES];
+    uint8_t m1[SRP_PROOF_BYTES];
+    uint8_t m2[SRP_PROOF_BYTES];
+    uint8_t controllerM1[SRP_PROOF_BYTES];
+} srp;
+
+/**
+ * Creates the provisioned SRP salt and verifier, and a controller public key A = g^a.
+ *
+ * - The first exponentiation also fills the SRP caches of the configured backend, so its cost is reported separately.
+ */
+static void SRPCreateSetupInfo(void) {
+    static const uint8_t zero[SRP_VERIFIER_BYTES];
+    uint8_t priv_a[SRP_SECRET_KEY_BYTES];
+
+    HAPPlatformRandomNumberFill(srp.salt, sizeof srp.salt);
+    HAP_srp_verifier(srp.v, srp.salt, kSRPUser, sizeof kSRPUser, kSetupCode, sizeof kSetupCode);
+
+    // B = k * v + g^b, so a zero verifier yields g^a.
+    HAPPlatformRandomNumberFill(priv_a, sizeof priv_a);
+    Measurement measurement = { .isWarmedUp = true };
+    MeasurementStart(&measurement);
+    HAP_srp_public_key(srp.pub_a, priv_a, zero);
+    MeasurementStop(&measurement);
+    Report("srp-public-key-cold", kSRPBackend, 0, &measurement);
+}
+
+typedef void (*SRPPublicKeyFunction)(
+        uint8_t pub_b[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]);
+
+typedef int (*SRPPremasterSecretFunction)(
+        uint8_t s[SRP_PREMASTER_SECRET_BYTES],
+        const uint8_t pub_a[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t u[SRP_SCRAMBLING_PARAMETER_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]);
+
+static void BenchmarkSRPExponentiations(
+        const char* backend,
+        SRPPublicKeyFunction publicKey,
+        SRPPremasterSecretFunction premasterSecret) {
+    Measurement publicKeyMeasurement = { 0 };
+    Measurement premasterSecretMeasurement = { 0 };
+    for (size_t i = 0; i <= kNumSRPIterations; i++) {
+        HAPPlatformRandomNumberFill(srp.priv_b, sizeof srp.priv_b);
+        MeasurementStart(&publicKeyMeasurement);
+        publicKey(srp.pub_b, srp.priv_b, srp.v);
+        MeasurementStop(&publicKeyMeasurement);
+
+        HAP_srp_scrambling_parameter(srp.u, srp.pub_a, srp.pub_b);
+        MeasurementStart(&premasterSecretMeasurement);
+        int e = premasterSecret(srp.s, srp.pub_a, srp.priv_b, srp.u, srp.v);
+        MeasurementStop(&premasterSecretMeasurement);
+        Check(e == 0, "SRP premaster secret");
+    }
+    Report("srp-public-key", backend, 0, &publicKeyMeasurement);
+    Report("srp-premaster-secret", backend, 0, &premasterSecretMeasurement);
+}
+
+/**
+ * Measures the SRP steps that do not depend on the optimized modular exponentiation.
+ */
+static void BenchmarkSRPHashes(void) {
+    Measurement verifier = { 0 };
+    Measurement scramblingParameter = { 0 };
+    Measurement sessionKey = { 0 };
+    Measurement proofM1 = { 0 };
+    Measurement proofM2 = { 0 };
+    for (size_t i = 0; i <= kNumSymmetricIterations; i++) {
+        if (i <= kNumSRPIterations) {
+            MeasurementStart(&verifier);
+            HAP_srp_verifier(srp.v, srp.salt, kSRPUser, sizeof kSRPUser, kSetupCode, sizeof kSetupCode);
+            MeasurementStop(&verifier);
+        }
+        MeasurementStart(&scramblingParameter);
+        HAP_srp_scrambling_parameter(srp.u, srp.pub_a, srp.pub_b);
+        MeasurementStop(&scramblingParameter);
+        MeasurementStart(&sessionKey);
+        HAP_srp_session_key(srp.k, srp.s);
+        MeasurementStop(&sessionKey);
+        MeasurementStart(&proofM1);
+        HAP_srp_proof_m1(srp.m1, kSRPUser, sizeof kSRPUser, srp.salt, srp.pub_a, srp.pub_b, srp.k);
+        MeasurementStop(&proofM1);
+        MeasurementStart(&proofM2);
+        HAP_srp_proof_m2(srp.m2, srp.pub_a, srp.m1, srp.k);
+        MeasurementStop(&proofM2);
+    }
+    Report("srp-verifier", "mbedtls", 0, &verifier);
+    Report("srp-scrambling-parameter", "mbedtls", 0, &scramblingParameter);
+    Report("srp-session-key", "mbedtls", 0, &sessionKey);
+    Report("srp-proof-m1", "mbedtls", 0, &proofM1);
+    Report("srp-proof-m2", "mbedtls", 0, &proofM2);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+/**
+ * TLV types of the encrypted sub-TLVs of pair-setup and pair-verify.
+ */
+/**@{*/
+#define kTLVType_Identifier ((uint8_t) 0x01)
+#define kTLVType_PublicKey  ((uint8_t) 0x03)
+#define kTLVType_Signature  ((uint8_t) 0x0A)
+/**@}*/
+
+/**
+ * Pairing identifiers. Controllers use a UUID, accessories their Device ID.
+ */
+static const char kControllerPairingID[] = "5C4F3B84-AF9A-4C3E-B5C1-7F2E6F0A9D21";
+static const char kAccessoryPairingID[] = "7A:3B:12:C4:5D:E6";
+
+/**
+ * Appends a TLV item with a value of less than 256 bytes.
+ */
+static void AppendTLV(
+        uint8_t* bytes,
+        size_t maxBytes,
+        size_t* numBytes,
+        uint8_t type,
+        const void* value,
+        size_t numValueBytes) {
+    HAPPrecondition(numValueBytes <= UINT8_MAX);
+    HAPPrecondition(*numBytes + 2 + numValueBytes <= maxBytes);
+
+    bytes[(*numBytes)++] = type;
+    bytes[(*numBytes)++] = (uint8_t) numValueBytes;
+    HAPRawBufferCopyBytes(&bytes[*numBytes], value, numValueBytes);
+    *numBytes += numValueBytes;
+}
+
+/**
+ * Derives a key with HKDF-SHA-512 from string salt and info.
+ */
+static void DeriveKey(
+        uint8_t* r,
+        size_t r_len,
+        const uint8_t* key,
+        size_t key_len,
+        const char* salt,
+        const char* info) {
+    HAP_hkdf_sha512(
+            r,
+            r_len,
+            key,
+            key_len,
+            (const uint8_t*) salt,
+            HAPStringGetNumBytes(salt),
+            (const uint8_t*) info,
+            HAPStringGetNumBytes(info));
+}
+
+/**
+ * Long-term keys of the accessory and of the controller.
+ */
+static struct {
+    uint8_t accessorySecretKey[ED25519_SECRET_KEY_BYTES];
+    uint8_t accessoryPublicKey[ED25519_PUBLIC_KEY_BYTES];
+    uint8_t controllerSecretKey[ED25519_SECRET_KEY_BYTES];
+    uint8_t controllerPublicKey[ED25519_PUBLIC_KEY_BYTES];
+} longTermKeys;
+
+/**
+ * Measures the accessory side of pair-setup M1 to M6 with the configured implementations.
+ *
+ * - The MFi authentication of M4 is not included.
+ *
+ * - The controller messages are computed outside of the measurement.
+ */
+static void BenchmarkPairSetup(void) {
+    uint8_t sessionKey[CHACHA20_POLY1305_KEY_BYTES];
+    uint8_t x[32];
+    uint8_t signedData[sizeof x + sizeof kControllerPairingID + ED25519_PUBLIC_KEY_BYTES];
+    uint8_t signature[ED25519_BYTES];
+    uint8_t subTLV[160];
+    uint8_t decrypted[sizeof subTLV];
+    uint8_t tag[CHACHA20_POLY1305_TAG_BYTES];
+    size_t numSubTLVBytes;
+
+    Measurement messages[3] = { { 0 } };
+    for (size_t i = 0; i <= kNumPairSetupIterations; i++) {
+        // M1 -> M2: SRP public key.
+        MeasurementStart(&messages[0]);
+        HAPPlatformRandomNumberFill(srp.priv_b, sizeof srp.priv_b);
+        HAP_srp_public_key(srp.pub_b, srp.priv_b, srp.v);
+        MeasurementStop(&messages[0]);
+
+        // Controller: M3. The accessory formulas yield the same session key as the controller ones.
+        HAP_srp_scrambling_parameter(srp.u, srp.pub_a, srp.pub_b);
+        Check(HAP_srp_premaster_secret(srp.s, srp.pub_a, srp.priv_b, srp.u, srp.v) == 0, "SRP premaster secret");
+        HAP_srp_session_key(srp.k, srp.s);
+        HAP_srp_proof_m1(srp.controllerM1, kSRPUser, sizeof kSRPUser, srp.salt, srp.pub_a, srp.pub_b, srp.k);
+        HAPRawBufferZero(srp.k, sizeof srp.k);
+
+        // M3 -> M4: SRP verify.
+        MeasurementStart(&messages[1]);
+        HAP_srp_scrambling_parameter(srp.u, srp.pub_a, srp.pub_b);
+        int e = HAP_srp_premaster_secret(srp.s, srp.pub_a, srp.priv_b, srp.u, srp.v);
+        HAP_srp_session_key(srp.k, srp.s);
+        HAP_srp_proof_m1(srp.m1, kSRPUser, sizeof kSRPUser, srp.salt, srp.pub_a, srp.pub_b, srp.k);
+        bool isValid = HAPRawBufferAreEqual(srp.m1, srp.controllerM1, sizeof srp.m1);
+        HAP_srp_proof_m2(srp.m2, srp.pub_a, srp.m1, srp.k);
+        MeasurementStop(&messages[1]);
+        Check(e == 0 && isValid, "Pair-setup M4");
+
+        // Controller: M5.
+        DeriveKey(
+                sessionKey,
+                sizeof sessionKey,
+                srp.k,
+                sizeof srp.k,
+                "Pair-Setup-Encrypt-Salt",
+                "Pair-Setup-Encrypt-Info");
+        DeriveKey(
+                x,
+                sizeof x,
+                srp.k,
+                sizeof srp.k,
+                "Pair-Setup-Controller-Sign-Salt",
+                "Pair-Setup-Controller-Sign-Info");
+        HAPRawBufferCopyBytes(&signedData[0], x, sizeof x);
+        HAPRawBufferCopyBytes(&signedData[sizeof x], kControllerPairingID, sizeof kControllerPairingID - 1);
+        HAPRawBufferCopyBytes(
+                &signedData[sizeof x + sizeof kControllerPairingID - 1],
+                longTermKeys.controllerPublicKey,
+                ED25519_PUBLIC_KEY_BYTES);
+        size_t numSignedBytes = sizeof signedData - 1;
+        HAP_ed25519_sign(
+                signature,
+                signedData,
+                numSignedBytes,
+                longTermKeys.controllerSecretKey,
+                longTermKeys.controllerPublicKey);
+        numSubTLVBytes = 0;
+        AppendTLV(
+                subTLV,
+                sizeof subTLV,
+                &numSubTLVBytes,
+                kTLVType_Identifier,
+                kControllerPairingID,
+                sizeof kControllerPairingID - 1);
+        AppendTLV(
+                subTLV,
+                sizeof subTLV,
+                &numSubTLVBytes,
+                kTLVType_PublicKey,
+                longTermKeys.controllerPublicKey,
+                ED25519_PUBLIC_KEY_BYTES);
+        AppendTLV(subTLV, sizeof subTLV, &numSubTLVBytes, kTLVType_Signature, signature, sizeof signature);
+        HAP_chacha20_poly1305_encrypt(
+                tag, subTLV, subTLV, numSubTLVBytes, (const uint8_t*) "PS-Msg05", 8, sessionKey);
+
+        // M5 -> M6: exchange of long-term public keys.
+        MeasurementStart(&messages[2]);
+        DeriveKey(
+                sessionKey,
+                sizeof sessionKey,
+                srp.k,
+                sizeof srp.k,
+                "Pair-Setup-Encrypt-Salt",
+                "Pair-Setup-Encrypt-Info");
+        e = HAP_chacha20_poly1305_decrypt(
+                tag, decrypted, subTLV, numSubTLVBytes, (const uint8_t*) "PS-Msg05", 8, sessionKey);
+        DeriveKey(
+                x,
+                sizeof x,
+                srp.k,
+                sizeof srp.k,
+                "Pair-Setup-Controller-Sign-Salt",
+                "Pair-Setup-Controller-Sign-Info");
+        HAPRawBufferCopyBytes(&signedData[0], x, sizeof x);
+        e |= HAP_ed25519_verify(
+                &decrypted[numSubTLVBytes - ED25519_BYTES],
+                signedData,
+                numSignedBytes,
+                longTermKeys.controllerPublicKey);
+        DeriveKey(
+                x,
+                sizeof x,
+                srp.k,
+                sizeof srp.k,
+                "Pair-Setup-Accessory-Sign-Salt",
+                "Pair-Setup-Accessory-Sign-Info");
+        HAPRawBufferCopyBytes(&signedData[0], x, sizeof x);
+        HAPRawBufferCopyBytes(&signedData[sizeof x], kAccessoryPairingID, sizeof kAccessoryPairingID - 1);
+        HAPRawBufferCopyBytes(
+                &signedData[sizeof x + sizeof kAccessoryPairingID - 1],
+                longTermKeys.accessoryPublicKey,
+                ED25519_PUBLIC_KEY_BYTES);
+        HAP_ed25519_sign(
+                signature,
+                signedData,
+                sizeof x + sizeof kAccessoryPairingID - 1 + ED25519_PUBLIC_KEY_BYTES,
+                longTermKeys.accessorySecretKey,
+                longTermKeys.accessoryPublicKey);
+        numSubTLVBytes = 0;
+        AppendTLV(
+                subTLV,
+                sizeof subTLV,
+                &numSubTLVBytes,
+                kTLVType_Identifier,
+                kAccessoryPairingID,
+                sizeof kAccessoryPairingID - 1);
+        AppendTLV(
+                subTLV,
+                sizeof subTLV,
+                &numSubTLVBytes,
+                kTLVType_PublicKey,
+                longTermKeys.accessoryPublicKey,
+                ED25519_PUBLIC_KEY_BYTES);
+        AppendTLV(subTLV, sizeof subTLV, &numSubTLVBytes, kTLVType_Signature, signature, sizeof signature);
+        HAP_chacha20_poly1305_encrypt(
+                tag, subTLV, subTLV, numSubTLVBytes, (const uint8_t*) "PS-Msg06", 8, sessionKey);
+        MeasurementStop(&messages[2]);
+        Check(e == 0, "Pair-setup M6");
+    }
+    Measurement total = { 0 };
+    for (size_t i = 0; i < HAPArrayCount(messages); i++) {
+        total.numIterations = messages[i].numIterations;
+        total.numCycles += messages[i].numCycles;
+        total.duration += messages[i].duration;
+    }
+    Report("pair-setup-m2", "configured", 0, &messages[0]);
+    Report("pair-setup-m4", "configured", 0, &messages[1]);
+    Report("pair-setup-m6", "configured", 0, &messages[2]);
+    Report("pair-setup", "configured", 0, &total);
+}
+
+/**
+ * Measures the accessory side of pair-verify M1 to M4 with the configured implementations.
+ *
+ * - The controller messages are computed outside of the measurement.
+ */
+static void BenchmarkPairVerify(void) {
+    uint8_t controllerEphemeralSecretKey[X25519_SCALAR_BYTES];
+    uint8_t controllerEphemeralPublicKey[X25519_BYTES];
+    uint8_t controllerSharedSecret[X25519_BYTES];
+    uint8_t accessoryEphemeralSecretKey[X25519_SCALAR_BYTES];
+    uint8_t accessoryEphemeralPublicKey[X25519_BYTES];
+    uint8_t sharedSecret[X25519_BYTES];
+    uint8_t sessionKey[CHACHA20_POLY1305_KEY_BYTES];
+    uint8_t controlKeys[2][CHACHA20_POLY1305_KEY_BYTES];
+    uint8_t info[2 * X25519_BYTES + sizeof kControllerPairingID];
+    uint8_t signature[ED25519_BYTES];
+    uint8_t subTLV[112];
+    uint8_t decrypted[sizeof subTLV];
+    uint8_t tag[CHACHA20_POLY1305_TAG_BYTES];
+    size_t numSubTLVBytes;
+
+    Measurement messages[2] = { { 0 } };
+    for (size_t i = 0; i <= kNumPairVerifyIterations; i++) {
+        // Controller: M1.
+        HAPPlatformRandomNumberFill(controllerEphemeralSecretKey, sizeof controllerEphemeralSecretKey);
+        HAP_X25519_scalarmult_base(controllerEphemeralPublicKey, controllerEphemeralSecretKey);
+
+        // M1 -> M2: ephemeral key exchange and accessory signature.
+        MeasurementStart(&messages[0]);
+        HAPPlatformRandomNumberFill(accessoryEphemeralSecretKey, sizeof accessoryEphemeralSecretKey);
+        HAP_X25519_scalarmult_base(accessoryEphemeralPublicKey, accessoryEphemeralSecretKey);
+        HAP_X25519_scalarmult(sharedSecret, accessoryEphemeralSecretKey, controllerEphemeralPublicKey);
+        HAPRawBufferCopyBytes(&info[0], accessoryEphemeralPublicKey, X25519_BYTES);
+        HAPRawBufferCopyBytes(&info[X25519_BYTES], kAccessoryPairingID, sizeof kAccessoryPairingID - 1);
+        HAPRawBufferCopyBytes(
+                &info[X25519_BYTES + sizeof kAccessoryPairingID - 1], controllerEphemeralPublicKey, X25519_BYTES);
+        HAP_ed25519_sign(
+                signature,
+                info,
+                2 * X25519_BYTES + sizeof kAccessoryPairingID - 1,
+                longTermKeys.accessorySecretKey,
+                longTermKeys.accessoryPublicKey);
+        DeriveKey(
+                sessionKey,
+                sizeof sessionKey,
+                sharedSecret,
+                sizeof sharedSecret,
+                "Pair-Verify-Encrypt-Salt",
+                "Pair-Verify-Encrypt-Info");
+        numSubTLVBytes = 0;
+        AppendTLV(
+                subTLV,
+                sizeof subTLV,
+                &numSubTLVBytes,
+                kTLVType_Identifier,
+                kAccessoryPairingID,
+                sizeof kAccessoryPairingID - 1);
+        AppendTLV(subTLV, sizeof subTLV, &numSubTLVBytes, kTLVType_Signature, signature, sizeof signature);
+        HAP_chacha20_poly1305_encrypt(
+                tag, subTLV, subTLV, numSubTLVBytes, (const uint8_t*) "PV-Msg02", 8, sessionKey);
+        MeasurementStop(&messages[0]);
+
+        // Controller: M3.
+        HAP_X25519_scalarmult(controllerSharedSecret, controllerEphemeralSecretKey, accessoryEphemeralPublicKey);
+        Check(HAPRawBufferAreEqual(controllerSharedSecret, sharedSecret, sizeof sharedSecret), "X25519 key exchange");
+        HAPRawBufferCopyBytes(&info[0], controllerEphemeralPublicKey, X25519_BYTES);
+        HAPRawBufferCopyBytes(&info[X25519_BYTES], kControllerPairingID, sizeof kControllerPairingID - 1);
+        HAPRawBufferCopyBytes(
+                &info[X25519_BYTES + sizeof kControllerPairingID - 1], accessoryEphemeralPublicKey, X25519_BYTES);
+        size_t numInfoBytes = sizeof info - 1;
+        HAP_ed25519_sign(
+                signature,
+                info,
+                numInfoBytes,
+                longTermKeys.controllerSecretKey,
+                longTermKeys.controllerPublicKey);
+        numSubTLVBytes = 0;
+        AppendTLV(
+                subTLV,
+                sizeof subTLV,
+                &numSubTLVBytes,
+                kTLVType_Identifier,
+                kControllerPairingID,
+                sizeof kControllerPairingID - 1);
+        AppendTLV(subTLV, sizeof subTLV, &numSubTLVBytes, kTLVType_Signature, signature, sizeof signature);
+        HAP_chacha20_poly1305_encrypt(
+                tag, subTLV, subTLV, numSubTLVBytes, (const uint8_t*) "PV-Msg03", 8, sessionKey);
+
+        // M3 -> M4: controller signature and session keys.
+        MeasurementStart(&messages[1]);
+        int e = HAP_chacha20_poly1305_decrypt(
+                tag, decrypted, subTLV, numSubTLVBytes, (const uint8_t*) "PV-Msg03", 8, sessionKey);
+        e |= HAP_ed25519_verify(
+                &decrypted[numSubTLVBytes - ED25519_BYTES], info, numInfoBytes, longTermKeys.controllerPublicKey);
+        DeriveKey(
+                controlKeys[0],
+                sizeof controlKeys[0],
+                sharedSecret,
+                sizeof sharedSecret,
+                "Control-Salt",
+                "Control-Read-Encryption-Key");
+        DeriveKey(
+                controlKeys[1],
+                sizeof controlKeys[1],
+                sharedSecret,
+                sizeof sharedSecret,
+                "Control-Salt",
+                "Control-Write-Encryption-Key");
+        MeasurementStop(&messages[1]);
+        Check(e == 0, "Pair-verify M4");
+    }
+    Measurement total = { 0 };
+    for (size_t i = 0; i < HAPArrayCount(messages); i++) {
+        total.numIterations = messages[i].numIterations;
+        total.numCycles += messages[i].numCycles;
+        total.duration += messages[i].duration;
+    }
+    Report("pair-verify-m2", "configured", 0, &messages[0]);
+    Report("pair-verify-m4", "configured", 0, &messages[1]);
+    Report("pair-verify", "configured", 0, &total);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+static void main_task(void* _Nullable context HAP_UNUSED) {
+    printf("{\"event\":\"start\",\"cycleCounter\":%s}\n", HAVE_CYCLE_COUNTER ? "true" : "false");
+
+    // Random number generator. Seeded before anything else uses it.
+    HAPPlatformRandomNumberCreate();
+
+    // Platform clock, which timestamps every HAP request.
+    BenchmarkClock();
+
+    // Symmetric primitives.
+    BenchmarkChaCha20Poly1305(
+            kChaCha20Poly1305Backend,
+            HAP_chacha20_poly1305_encrypt_aad,
+            HAP_chacha20_poly1305_decrypt_aad);
+#if CONFIG_HAP_CRYPTO_CHACHA20_POLY1305
+    BenchmarkChaCha20Poly1305(
+            "mbedtls", __real_HAP_chacha20_poly1305_encrypt_aad, __real_HAP_chacha20_poly1305_decrypt_aad);
+#endif
+    BenchmarkSHA512();
+    BenchmarkHKDF(kHKDFBackend, HAP_hkdf_sha512);
+#if CONFIG_HAP_CRYPTO_HKDF
+    BenchmarkHKDF("mbedtls", __real_HAP_hkdf_sha512);
+#endif
+
+    // Curve25519.
+    BenchmarkCurve25519(&(const Curve25519Implementation) { .backend = kCurve25519Backend,
+                                                             .scalarmultBase = HAP_X25519_scalarmult_base,
+                                                             .scalarmult = HAP_X25519_scalarmult,
+                                                             .sign = HAP_ed25519_sign,
+                                                             .verify = HAP_ed25519_verify });
+#if CONFIG_HAP_CRYPTO_CURVE25519
+    BenchmarkCurve25519(&(const Curve25519Implementation) { .backend = "mbedtls",
+                                                             .scalarmultBase = __real_HAP_X25519_scalarmult_base,
+                                                             .scalarmult = __real_HAP_X25519_scalarmult,
+                                                             .sign = __real_HAP_ed25519_sign,
+                                                             .verify = __real_HAP_ed25519_verify });
+#endif
+
+    // SRP.
+    SRPCreateSetupInfo();
+    BenchmarkSRPExponentiations(kSRPBackend, HAP_srp_public_key, HAP_srp_premaster_secret);
+#if CONFIG_HAP_CRYPTO_SRP
+    BenchmarkSRPExponentiations("mbedtls", __real_HAP_srp_public_key, __real_HAP_srp_premaster_secret);
+#endif
+    BenchmarkSRPHashes();
+
+    // Transcripts.
+    HAPPlatformRandomNumberFill(longTermKeys.accessorySecretKey, sizeof longTermKeys.accessorySecretKey);
+    HAP_ed25519_public_key(longTermKeys.accessoryPublicKey, longTermKeys.accessorySecretKey);
+    HAPPlatformRandomNumberFill(longTermKeys.controllerSecretKey, sizeof longTermKeys.controllerSecretKey);
+    HAP_ed25519_public_key(longTermKeys.controllerPublicKey, longTermKeys.controllerSecretKey);
+    BenchmarkPairSetup();
+    BenchmarkPairVerify();
+
+    printf("{\"event\":\"done\"}\n");
+    fflush(stdout);
+    vTaskDelete(NULL);
+}
+
+void app_main() {
+    // The mbedTLS SRP implementation needs a large stack.
+    xTaskCreate(main_task, "main_task", 12 * 1024, NULL, 6, NULL);
+}
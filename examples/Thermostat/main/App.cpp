@@ -26,6 +26,7 @@
 //   6. Callbacks that notify the server in case their associated value has changed.
 
 #include "HAP.h"
+#include "HAPPlatformWallClock+Init.h"
 
 #include "App.h"
 #include "DB.h"
@@ -33,7 +34,6 @@
 #include "driver/gpio.h"
 #include "esp_sntp.h"
 #include "esp_timer.h"
-#include "time.h"
 
 void UpdateOutputsAndNotify();
 
@@ -249,14 +249,10 @@ class DutyCycleTimer : Timer {
             // Convert duty cycle frpm % of hour.
             timeout_ticks = accessoryConfiguration.state.fanDutyCycle * TICKS_PER_MIN * 60 / 100;
         } else {
-            // timeout determined by minutes
-            time_t now_raw = time(NULL);
-            struct tm *now;
-            now = localtime (&now_raw);
-            float timeout = minutes_start - (now->tm_min + now->tm_sec/60.0f);
-            if (timeout <= 0)
-                timeout += 60;
-            timeout_ticks = (uint64_t)(timeout * TICKS_PER_MIN);
+            // timeout determined by minutes past the hour
+            HAPTime now = HAPPlatformClockGetCurrent();
+            HAPTime deadline = HAPPlatformWallClockGetNextBoundary(now, 60 * TICKS_PER_MIN, minutes_start * TICKS_PER_MIN);
+            timeout_ticks = deadline - now;
         }
         HAPLog(&logObject, "DutyCycle fan is %s. Will toggle in %g min.",
             fanActive ? "on" : "off", ((float)timeout_ticks) / TICKS_PER_MIN);
@@ -290,7 +286,9 @@ class DutyCycleTimer : Timer {
 };
 static DutyCycleTimer dutyCycleTimer;
 
-void sntp_sync_callback(struct timeval *tv) {
+static HAPPlatformWallClockObserver wallClockObserver;
+
+static void HandleWallClockChanged(void* _Nullable context, int64_t adjustment) {
     dutyCycleTimer.time_changed_callback();
 }
 
@@ -668,8 +666,8 @@ void AppCreate(HAPAccessoryServerRef* server, HAPPlatformKeyValueStoreRef keyVal
     sntp_setoperatingmode(SNTP_OPMODE_POLL);
     sntp_setservername(0, "pool.ntp.org");
     sntp_init();
-    sntp_set_time_sync_notification_cb(&sntp_sync_callback);
-    
+    HAPPlatformWallClockAddObserver(&wallClockObserver, HandleWallClockChanged, NULL);
+
     HAPRawBufferZero(&accessoryConfiguration, sizeof accessoryConfiguration);
     accessoryConfiguration.server = server;
     accessoryConfiguration.keyValueStore = keyValueStore;
@@ -678,6 +676,7 @@ void AppCreate(HAPAccessoryServerRef* server, HAPPlatformKeyValueStoreRef keyVal
 }
 
 void AppRelease(void) {
+    HAPPlatformWallClockRemoveObserver(&wallClockObserver);
 }
 
 void AppAccessoryServerStart(void) {
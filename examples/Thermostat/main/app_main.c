@@ -9,6 +9,9 @@
 // software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
 // CONDITIONS OF ANY KIND, either express or implied.
 
+#include <stdalign.h>
+#include <stddef.h>
+
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include "App.h"
@@ -19,10 +22,18 @@
 #include "HAPPlatform+Init.h"
 #include "HAPPlatformAccessorySetup+Init.h"
 #include "HAPPlatformBLEPeripheralManager+Init.h"
+#if CONFIG_HAP_BLE_SESSION_CACHE_PERSIST
+#include "HAPPlatformBLESessionCache+Init.h"
+#endif
+#include "HAPPlatformCrypto+Init.h"
+#include "HAPPlatformI2CBus+Init.h"
 #include "HAPPlatformKeyValueStore+Init.h"
 #include "HAPPlatformMFiHWAuth+Init.h"
 #include "HAPPlatformMFiTokenAuth+Init.h"
+#include "HAPPlatformRandomNumber+Init.h"
 #include "HAPPlatformRunLoop+Init.h"
+#include "HAPPlatformTransportArena+Init.h"
+#include "HAPPlatformWallClock+Init.h"
 #if IP
 #include "HAPPlatformServiceDiscovery+Init.h"
 #include "HAPPlatformTCPStreamManager+Init.h"
@@ -33,6 +44,12 @@ static bool requestedFactoryReset = false;
 static bool clearPairings = false;
 
 #define PREFERRED_ADVERTISING_INTERVAL (HAPBLEAdvertisingIntervalCreateFromMilliseconds(417.5f))
+
+/**
+ * Number of lwIP sockets that are not available to IP sessions: the listening socket, the two loopback sockets of the
+ * run loop and the spare TCP stream.
+ */
+#define kNumReservedSockets ((size_t) 4)
 void app_wifi_init(void);
 esp_err_t app_wifi_connect(void);
 /**
@@ -56,6 +73,8 @@ static struct {
 
     HAPPlatformMFiHWAuth mfiHWAuth;
     HAPPlatformMFiTokenAuth mfiTokenAuth;
+
+    HAPPlatformTransportArena transportArena;
 } platform;
 
 /**
@@ -83,6 +102,9 @@ extern const HAPAccessory* AppGetAccessoryInfo();
  * Initialize global platform objects.
  */
 static void InitializePlatform() {
+    // Random number generator. Must be seeded before Wi-Fi is started.
+    HAPPlatformRandomNumberCreate();
+
     // Key-value store.
     HAPPlatformKeyValueStoreCreate(&platform.keyValueStore, &(const HAPPlatformKeyValueStoreOptions) {
         .part_name = "nvs",
@@ -106,14 +128,14 @@ static void InitializePlatform() {
     // Initialise Wi-Fi
     app_wifi_init();
 
-#if IP
-    // TCP stream manager.
-    HAPPlatformTCPStreamManagerCreate(&platform.tcpStreamManager, &(const HAPPlatformTCPStreamManagerOptions) {
-        /* Listen on all available network interfaces. */
-        .port = 0 /* Listen on unused port number from the ephemeral port range. */,
-        .maxConcurrentTCPStreams = 9
+    // Transport memory. IP and BLE accessory server storage is carved from one shared budget.
+    static uint8_t transportArenaBytes[CONFIG_HAP_TRANSPORT_ARENA_SIZE];
+    HAPPlatformTransportArenaCreate(&platform.transportArena, &(const HAPPlatformTransportArenaOptions) {
+        .bytes = transportArenaBytes,
+        .numBytes = sizeof transportArenaBytes
     });
 
+#if IP
     // Service discovery.
     static HAPPlatformServiceDiscovery serviceDiscovery;
     HAPPlatformServiceDiscoveryCreate(&serviceDiscovery, &(const HAPPlatformServiceDiscoveryOptions) {
@@ -132,8 +154,17 @@ static void InitializePlatform() {
     platform.hapPlatform.ble.blePeripheralManager = &blePeripheralManager;
 #endif
 
+#if CONFIG_HAP_I2C_BUS
+    // I2C bus.
+    HAPPlatformI2CBusCreate(&(const HAPPlatformI2CBusOptions) {
+        .sdaGPIO = CONFIG_HAP_I2C_SDA_GPIO,
+        .sclGPIO = CONFIG_HAP_I2C_SCL_GPIO,
+        .clockSpeed = CONFIG_HAP_IC2_SPEED
+    });
+#endif
+
 #if HAVE_MFI_HW_AUTH
-    // Apple Authentication Coprocessor provider.
+    // Apple Authentication Coprocessor provider. Depends on I2C bus.
     HAPPlatformMFiHWAuthCreate(&platform.mfiHWAuth);
 #endif
 
@@ -149,12 +180,20 @@ static void InitializePlatform() {
     // Run loop.
     HAPPlatformRunLoopCreate(&(const HAPPlatformRunLoopOptions) { .keyValueStore = &platform.keyValueStore });
 
+    // Wall clock. Depends on run loop.
+    HAPPlatformWallClockCreate();
+
     platform.hapAccessoryServerOptions.maxPairings = kHAPPairingStorage_MinElements;
 
     platform.hapPlatform.authentication.mfiTokenAuth =
             HAPPlatformMFiTokenAuthIsProvisioned(&platform.mfiTokenAuth) ? &platform.mfiTokenAuth : NULL;
 
    platform.hapAccessoryServerCallbacks.handleUpdatedState = HandleUpdatedState;
+
+#if CONFIG_HAP_CRYPTO_SELF_TEST
+    // Optimized crypto self-test.
+    HAPPlatformCryptoSelfTest();
+#endif
 }
 
 /**
@@ -166,6 +205,11 @@ static void DeinitializePlatform() {
     HAPPlatformMFiHWAuthRelease(&platform.mfiHWAuth);
 #endif
 
+#if CONFIG_HAP_I2C_BUS
+    // I2C bus.
+    HAPPlatformI2CBusRelease();
+#endif
+
 #if IP
     // TCP stream manager.
     HAPPlatformTCPStreamManagerRelease(&platform.tcpStreamManager);
@@ -173,6 +217,9 @@ static void DeinitializePlatform() {
 
     AppDeinitialize();
 
+    // Wall clock.
+    HAPPlatformWallClockRelease();
+
     // Run loop.
     HAPPlatformRunLoopRelease();
 }
@@ -181,6 +228,9 @@ static void DeinitializePlatform() {
  * Restore platform specific factory settings.
  */
 void RestorePlatformFactorySettings(void) {
+#if BLE && CONFIG_HAP_BLE_SESSION_CACHE_PERSIST
+    HAPPlatformBLESessionCacheInvalidate();
+#endif
 }
 
 /**
@@ -229,40 +279,111 @@ void HandleUpdatedState(HAPAccessoryServerRef* _Nonnull server, void* _Nullable
             HAPAssert(err == kHAPError_Unknown);
             HAPFatalError();
         }
+#if BLE && CONFIG_HAP_BLE_SESSION_CACHE_PERSIST
+        HAPPlatformBLESessionCacheInvalidate();
+#endif
         AppAccessoryServerStart();
     } else {
         AccessoryServerHandleUpdatedState(server, context);
     }
 }
 
+/**
+ * Borrows accessory server storage from the transport arena.
+ */
+static void* TransportArenaAllocate(HAPPlatformTransportArenaUser user, size_t numBytes) {
+    void* bytes = HAPPlatformTransportArenaAllocate(&platform.transportArena, user, numBytes);
+    if (!bytes) {
+        HAPLogError(&kHAPLog_Default, "Transport storage does not fit. Increase CONFIG_HAP_TRANSPORT_ARENA_SIZE.");
+        HAPFatalError();
+    }
+    return bytes;
+}
+
 #if IP
 static void InitializeIP() {
     // Prepare accessory server storage.
-    static HAPIPSession ipSessions[kHAPIPSessionStorage_MinimumNumElements];
-    static uint8_t ipInboundBuffers[HAPArrayCount(ipSessions)][kHAPIPSession_MinimumInboundBufferSize];
-    static uint8_t ipOutboundBuffers[HAPArrayCount(ipSessions)][kHAPIPSession_MinimumOutboundBufferSize];
-    static HAPIPEventNotificationRef ipEventNotifications[HAPArrayCount(ipSessions)][kAttributeCount];
-    for (size_t i = 0; i < HAPArrayCount(ipSessions); i++) {
-        ipSessions[i].inboundBuffer.bytes = ipInboundBuffers[i];
-        ipSessions[i].inboundBuffer.numBytes = sizeof ipInboundBuffers[i];
-        ipSessions[i].outboundBuffer.bytes = ipOutboundBuffers[i];
-        ipSessions[i].outboundBuffer.numBytes = sizeof ipOutboundBuffers[i];
-        ipSessions[i].eventNotifications = ipEventNotifications[i];
-        ipSessions[i].numEventNotifications = HAPArrayCount(ipEventNotifications[i]);
+    HAPIPReadContextRef* ipReadContexts =
+            TransportArenaAllocate(kHAPPlatformTransportArenaUser_IP, kAttributeCount * sizeof ipReadContexts[0]);
+    HAPIPWriteContextRef* ipWriteContexts =
+            TransportArenaAllocate(kHAPPlatformTransportArenaUser_IP, kAttributeCount * sizeof ipWriteContexts[0]);
+    uint8_t* ipScratchBuffer =
+            TransportArenaAllocate(kHAPPlatformTransportArenaUser_IP, kHAPIPSession_MinimumScratchBufferSize);
+
+    // Sessions take what is left of the transport budget, with the HAP minimum as a floor. Every session needs its own
+    // lwIP socket, which caps their number. Each of the four session allocations below may be preceded by alignment
+    // padding.
+    size_t numSessionBytes = sizeof(HAPIPSession) + kHAPIPSession_MinimumInboundBufferSize +
+                             kHAPIPSession_MinimumOutboundBufferSize +
+                             kAttributeCount * sizeof(HAPIPEventNotificationRef);
+    size_t numPaddingBytes = 4 * (alignof(max_align_t) - 1);
+    size_t numFreeBytes = HAPPlatformTransportArenaGetNumFreeBytes(&platform.transportArena);
+    size_t numSessions = numFreeBytes > numPaddingBytes ? (numFreeBytes - numPaddingBytes) / numSessionBytes : 0;
+    if (numSessions < kHAPIPSessionStorage_MinimumNumElements) {
+        HAPLogError(
+                &kHAPLog_Default,
+                "Transport budget only fits %zu of the %u IP sessions required by HAP. "
+                "Increase CONFIG_HAP_TRANSPORT_ARENA_SIZE.",
+                numSessions,
+                kHAPIPSessionStorage_MinimumNumElements);
+        HAPFatalError();
+    }
+    size_t numSockets = CONFIG_LWIP_MAX_SOCKETS;
+    size_t maxSessions = numSockets > kNumReservedSockets ? numSockets - kNumReservedSockets : 0;
+    if (maxSessions < kHAPIPSessionStorage_MinimumNumElements) {
+        HAPLogError(
+                &kHAPLog_Default,
+                "%zu lwIP sockets only fit %zu of the %u IP sessions required by HAP. "
+                "Increase CONFIG_LWIP_MAX_SOCKETS.",
+                numSockets,
+                maxSessions,
+                kHAPIPSessionStorage_MinimumNumElements);
+        HAPFatalError();
     }
-    static HAPIPReadContextRef ipReadContexts[kAttributeCount];
-    static HAPIPWriteContextRef ipWriteContexts[kAttributeCount];
-    static uint8_t ipScratchBuffer[kHAPIPSession_MinimumScratchBufferSize];
-    static HAPIPAccessoryServerStorage ipAccessoryServerStorage = {
+    if (numSessions > maxSessions) {
+        HAPLogInfo(
+                &kHAPLog_Default,
+                "Transport budget fits %zu IP sessions, lwIP sockets only %zu. "
+                "Lower CONFIG_HAP_TRANSPORT_ARENA_SIZE or increase CONFIG_LWIP_MAX_SOCKETS.",
+                numSessions,
+                maxSessions);
+        numSessions = maxSessions;
+    }
+    HAPIPSession* ipSessions =
+            TransportArenaAllocate(kHAPPlatformTransportArenaUser_IP, numSessions * sizeof ipSessions[0]);
+    uint8_t* ipInboundBuffers = TransportArenaAllocate(
+            kHAPPlatformTransportArenaUser_IP, numSessions * kHAPIPSession_MinimumInboundBufferSize);
+    uint8_t* ipOutboundBuffers = TransportArenaAllocate(
+            kHAPPlatformTransportArenaUser_IP, numSessions * kHAPIPSession_MinimumOutboundBufferSize);
+    HAPIPEventNotificationRef* ipEventNotifications = TransportArenaAllocate(
+            kHAPPlatformTransportArenaUser_IP, numSessions * kAttributeCount * sizeof ipEventNotifications[0]);
+    for (size_t i = 0; i < numSessions; i++) {
+        ipSessions[i].inboundBuffer.bytes = &ipInboundBuffers[i * kHAPIPSession_MinimumInboundBufferSize];
+        ipSessions[i].inboundBuffer.numBytes = kHAPIPSession_MinimumInboundBufferSize;
+        ipSessions[i].outboundBuffer.bytes = &ipOutboundBuffers[i * kHAPIPSession_MinimumOutboundBufferSize];
+        ipSessions[i].outboundBuffer.numBytes = kHAPIPSession_MinimumOutboundBufferSize;
+        ipSessions[i].eventNotifications = &ipEventNotifications[i * kAttributeCount];
+        ipSessions[i].numEventNotifications = kAttributeCount;
+    }
+    static HAPIPAccessoryServerStorage ipAccessoryServerStorage;
+    ipAccessoryServerStorage = (HAPIPAccessoryServerStorage) {
         .sessions = ipSessions,
-        .numSessions = HAPArrayCount(ipSessions),
+        .numSessions = numSessions,
         .readContexts = ipReadContexts,
-        .numReadContexts = HAPArrayCount(ipReadContexts),
+        .numReadContexts = kAttributeCount,
         .writeContexts = ipWriteContexts,
-        .numWriteContexts = HAPArrayCount(ipWriteContexts),
-        .scratchBuffer = { .bytes = ipScratchBuffer, .numBytes = sizeof ipScratchBuffer }
+        .numWriteContexts = kAttributeCount,
+        .scratchBuffer = { .bytes = ipScratchBuffer, .numBytes = kHAPIPSession_MinimumScratchBufferSize }
     };
 
+    // TCP stream manager. One spare stream lets the IP accessory server accept a connection while all sessions are in
+    // use, instead of the TCP stack refusing it.
+    HAPPlatformTCPStreamManagerCreate(&platform.tcpStreamManager, &(const HAPPlatformTCPStreamManagerOptions) {
+        /* Listen on all available network interfaces. */
+        .port = 0 /* Listen on unused port number from the ephemeral port range. */,
+        .maxConcurrentTCPStreams = numSessions + 1
+    });
+
     platform.hapAccessoryServerOptions.ip.transport = &kHAPAccessoryServerTransport_IP;
     platform.hapAccessoryServerOptions.ip.accessoryServerStorage = &ipAccessoryServerStorage;
 
@@ -275,27 +396,49 @@ static void InitializeIP() {
 
 #if BLE
 static void InitializeBLE() {
-    static HAPBLEGATTTableElementRef gattTableElements[kAttributeCount];
-    static HAPBLESessionCacheElementRef sessionCacheElements[kHAPBLESessionCache_MinElements];
     static HAPSessionRef session;
-    static uint8_t procedureBytes[2048];
-    static HAPBLEProcedureRef procedures[1];
+    HAPBLEGATTTableElementRef* gattTableElements =
+            TransportArenaAllocate(kHAPPlatformTransportArenaUser_BLE, kAttributeCount * sizeof gattTableElements[0]);
+#if CONFIG_HAP_BLE_SESSION_CACHE_PERSIST
+    // Session cache in RTC memory. Kept across restarts within the configured timeout.
+    HAPPlatformBLESessionCacheCreate();
+    size_t numSessionCacheElements;
+    HAPBLESessionCacheElementRef* sessionCacheElements =
+            HAPPlatformBLESessionCacheGetElements(&numSessionCacheElements);
+#else
+    size_t numSessionCacheElements = kHAPBLESessionCache_MinElements;
+    HAPBLESessionCacheElementRef* sessionCacheElements = TransportArenaAllocate(
+            kHAPPlatformTransportArenaUser_BLE, numSessionCacheElements * sizeof sessionCacheElements[0]);
+#endif
+    HAPBLEProcedureRef* procedures = TransportArenaAllocate(
+            kHAPPlatformTransportArenaUser_BLE, CONFIG_HAP_BLE_NUM_PROCEDURES * sizeof procedures[0]);
+    size_t numProcedureBytes = CONFIG_HAP_BLE_NUM_PROCEDURES * CONFIG_HAP_BLE_PROCEDURE_BUFFER_SIZE;
+    uint8_t* procedureBytes = TransportArenaAllocate(kHAPPlatformTransportArenaUser_BLE, numProcedureBytes);
 
-    static HAPBLEAccessoryServerStorage bleAccessoryServerStorage = {
+    static HAPBLEAccessoryServerStorage bleAccessoryServerStorage;
+    bleAccessoryServerStorage = (HAPBLEAccessoryServerStorage) {
         .gattTableElements = gattTableElements,
-        .numGATTTableElements = HAPArrayCount(gattTableElements),
+        .numGATTTableElements = kAttributeCount,
         .sessionCacheElements = sessionCacheElements,
-        .numSessionCacheElements = HAPArrayCount(sessionCacheElements),
+        .numSessionCacheElements = numSessionCacheElements,
         .session = &session,
         .procedures = procedures,
-        .numProcedures = HAPArrayCount(procedures),
-        .procedureBuffer = { .bytes = procedureBytes, .numBytes = sizeof procedureBytes }
+        .numProcedures = CONFIG_HAP_BLE_NUM_PROCEDURES,
+        .procedureBuffer = { .bytes = procedureBytes, .numBytes = numProcedureBytes }
     };
 
     platform.hapAccessoryServerOptions.ble.transport = &kHAPAccessoryServerTransport_BLE;
     platform.hapAccessoryServerOptions.ble.accessoryServerStorage = &bleAccessoryServerStorage;
     platform.hapAccessoryServerOptions.ble.preferredAdvertisingInterval = PREFERRED_ADVERTISING_INTERVAL;
     platform.hapAccessoryServerOptions.ble.preferredNotificationDuration = kHAPBLENotification_MinDuration;
+
+    // The procedure buffer is split evenly between the procedures.
+    HAPLogInfo(
+            &kHAPLog_Default,
+            "HAP-BLE procedures: %u x %u bytes (%zu bytes total).",
+            CONFIG_HAP_BLE_NUM_PROCEDURES,
+            CONFIG_HAP_BLE_PROCEDURE_BUFFER_SIZE,
+            numProcedureBytes);
 }
 #endif
 
@@ -306,13 +449,16 @@ void main_task()
     // Initialize global platform objects.
     InitializePlatform();
 
+    // BLE storage has a fixed size. IP sessions take what is left of the transport budget.
+#if BLE
+    InitializeBLE();
+#endif
+
 #if IP
     InitializeIP();
 #endif
 
-#if BLE
-    InitializeBLE();
-#endif
+    HAPPlatformTransportArenaLogUsage(&platform.transportArena);
 
     // Perform Application-specific initalizations such as setting up callbacks
     // and configure any additional unique platform dependencies
@@ -326,6 +472,11 @@ void main_task()
             &platform.hapAccessoryServerCallbacks,
             /* context: */ NULL);
 
+#if BLE && CONFIG_HAP_BLE_SESSION_CACHE_PERSIST
+    // Resume HAP-BLE sessions from before the restart. Depends on accessory server.
+    HAPPlatformBLESessionCacheRestore();
+#endif
+
     // Create app object.
     AppCreate(&accessoryServer, &platform.keyValueStore);
 
@@ -73,6 +73,15 @@ struct HAPPlatformAccessorySetup {
     // Opaque type. Do not access the instance fields directly.
     /**@cond */
     HAPPlatformKeyValueStoreRef keyValueStore;
+
+    // Provisioning data does not change at runtime and is served from RAM after the first load.
+    HAPSetupInfo setupInfo;
+    HAPSetupCode setupCode;
+    HAPSetupID setupID;
+    bool setupInfoIsCached : 1;
+    bool setupCodeIsCached : 1;
+    bool setupIDIsCached : 1;
+    bool setupIDIsValid : 1;
     /**@endcond */
 };
 
@@ -31,6 +31,19 @@ extern "C" {
 #pragma clang assume_nonnull begin
 #endif
 
+/**@file
+ * HAP-BLE peripheral manager.
+ *
+ * Keeps the GATT database, the advertising state and the connection state of the HAP-BLE accessory server: fast
+ * advertising bursts, ATT MTU and LE data length negotiation, connection parameter adaptation, GATT database change
+ * detection and double-buffered advertising payloads.
+ *
+ * - This is the platform side only. No adapter to a Bluetooth stack (NimBLE or Bluedroid) exists yet, and the examples
+ *   are built for HAP-IP only, so nothing here is driven on a device. An adapter must forward stack events to the
+ *   HAPPlatformBLEPeripheralManagerHandle* functions and apply the changes requested through the
+ *   updateConnectionParameters and updateAdvertisingData callbacks.
+ */
+
 typedef struct {
     HAPPlatformBLEPeripheralManagerUUID type;
     bool isPrimary;
@@ -67,14 +80,260 @@ typedef struct {
     } _;
 } HAPPlatformBLEPeripheralManagerAttribute;
 
+/**
+ * Default advertising interval used during a fast advertising burst.
+ */
+#define kHAPPlatformBLEPeripheralManager_DefaultFastAdvertisingInterval \
+    (HAPBLEAdvertisingIntervalCreateFromMilliseconds(20))
+
+/**
+ * Default duration of a fast advertising burst in milliseconds.
+ */
+#define kHAPPlatformBLEPeripheralManager_DefaultFastAdvertisingDuration ((HAPTime)(3 * HAPSecond))
+
+/**
+ * ATT MTU that is in effect until an MTU exchange completes.
+ *
+ * @see Bluetooth Core Specification Version 5.0, Vol 3, Part F, Section 3.2.8 Exchanging MTU Size
+ */
+#define kHAPPlatformBLEPeripheralManager_DefaultATTMTU ((uint16_t) 23)
+
+/**
+ * Largest ATT MTU that may be negotiated.
+ *
+ * - The maximum length of an attribute value is 512 bytes. A read response carries 1 byte of opcode.
+ */
+#define kHAPPlatformBLEPeripheralManager_MaxATTMTU ((uint16_t) 517)
+
+/**
+ * LE Data Length (maximum link layer payload) that is in effect until the Data Length Update Procedure completes.
+ *
+ * @see Bluetooth Core Specification Version 5.0, Vol 6, Part B, Section 4.5.10 Data Length Update Procedure
+ */
+#define kHAPPlatformBLEPeripheralManager_DefaultDataLength ((uint16_t) 27)
+
+/**
+ * Largest LE Data Length that may be negotiated.
+ */
+#define kHAPPlatformBLEPeripheralManager_MaxDataLength ((uint16_t) 251)
+
+/**
+ * LE connection parameters.
+ *
+ * @see Bluetooth Core Specification Version 5.0, Vol 3, Part A, Section 4.20 Connection Parameter Update Request
+ */
+typedef struct {
+    /** Minimum connection interval in 1.25 ms units. */
+    uint16_t minInterval;
+
+    /** Maximum connection interval in 1.25 ms units. */
+    uint16_t maxInterval;
+
+    /** Number of connection events the peripheral may skip. */
+    uint16_t slaveLatency;
+
+    /** Supervision timeout in 10 ms units. */
+    uint16_t supervisionTimeout;
+} HAPPlatformBLEPeripheralManagerConnectionParameters;
+
+/**
+ * Default connection parameters while HAP-BLE procedures are active (7.5 - 15 ms interval).
+ */
+#define kHAPPlatformBLEPeripheralManager_DefaultActiveConnectionParameters \
+    ((HAPPlatformBLEPeripheralManagerConnectionParameters) { \
+            .minInterval = 6, .maxInterval = 12, .slaveLatency = 0, .supervisionTimeout = 400 })
+
+/**
+ * Default connection parameters after a quiet period (300 - 500 ms interval).
+ */
+#define kHAPPlatformBLEPeripheralManager_DefaultIdleConnectionParameters \
+    ((HAPPlatformBLEPeripheralManagerConnectionParameters) { \
+            .minInterval = 240, .maxInterval = 400, .slaveLatency = 4, .supervisionTimeout = 600 })
+
+/**
+ * Default time without GATT traffic after which the idle connection parameters are requested.
+ */
+#define kHAPPlatformBLEPeripheralManager_DefaultQuietDuration ((HAPTime)(2 * HAPSecond))
+
+/**
+ * Requests new connection parameters from the BLE stack.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      connectionHandle     Connection handle of the connected central.
+ * @param      parameters           Requested connection parameters.
+ * @param      context              The context parameter given to the HAPPlatformBLEPeripheralManagerCreate function.
+ */
+typedef void (*HAPPlatformBLEPeripheralManagerUpdateConnectionParametersCallback)(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle,
+        const HAPPlatformBLEPeripheralManagerConnectionParameters* parameters,
+        void* _Nullable context);
+
+/**
+ * Hands a new advertising payload to the BLE stack.
+ *
+ * - The buffers stay valid and unchanged until the callback is invoked again, so the BLE stack may reference them
+ *   instead of copying them.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      advertisingBytes     Advertising data.
+ * @param      numAdvertisingBytes  Length of advertising data.
+ * @param      scanResponseBytes    Scan response data, if available.
+ * @param      numScanResponseBytes Length of scan response data.
+ * @param      context              The context parameter given to the HAPPlatformBLEPeripheralManagerCreate function.
+ */
+typedef void (*HAPPlatformBLEPeripheralManagerUpdateAdvertisingDataCallback)(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        const void* advertisingBytes,
+        size_t numAdvertisingBytes,
+        const void* _Nullable scanResponseBytes,
+        size_t numScanResponseBytes,
+        void* _Nullable context);
+
+/**
+ * Hands the advertising interval that is in effect to the BLE stack.
+ *
+ * - Called when advertising starts or stops, when the accessory server requests a different advertising interval and
+ *   when a fast advertising burst starts or ends.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      advertisingInterval  Advertising interval. 0 if advertising has stopped.
+ * @param      context              The context parameter given to the HAPPlatformBLEPeripheralManagerCreate function.
+ */
+typedef void (*HAPPlatformBLEPeripheralManagerUpdateAdvertisingIntervalCallback)(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPBLEAdvertisingInterval advertisingInterval,
+        void* _Nullable context);
+
+/**
+ * Connection statistics.
+ */
+typedef struct {
+    /** Time spent connected with the active connection parameters in milliseconds. */
+    HAPTime activeDuration;
+
+    /** Time spent connected with the idle connection parameters in milliseconds. */
+    HAPTime idleDuration;
+
+    /** Number of connection parameter updates that were requested. */
+    uint32_t numConnectionParameterUpdates;
+
+    /** Number of completed HAP-BLE transactions (write request followed by read of the response). */
+    uint32_t numProcedures;
+
+    /** Sum of the latencies of all completed HAP-BLE transactions in milliseconds. */
+    HAPTime totalProcedureLatency;
+
+    /** Largest latency of a completed HAP-BLE transaction in milliseconds. */
+    HAPTime maxProcedureLatency;
+} HAPPlatformBLEPeripheralManagerStatistics;
+
 /**
  * BLE peripheral manager initialization options.
  */
 typedef struct {
     HAPPlatformBLEPeripheralManagerAttribute* attributes;
     size_t numAttributes;
+
+    /**
+     * Key-value store used to remember the GATT database layout across reboots.
+     *
+     * - If NULL, every published GATT database is treated as changed.
+     */
+    HAPPlatformKeyValueStoreRef _Nullable keyValueStore;
+
+    /**
+     * Advertising interval used for a burst after the advertising data changed or a central disconnected.
+     *
+     * - If 0, kHAPPlatformBLEPeripheralManager_DefaultFastAdvertisingInterval is used.
+     * - The interval requested by the accessory server is used instead if it is shorter.
+     */
+    HAPBLEAdvertisingInterval fastAdvertisingInterval;
+
+    /**
+     * Duration of a fast advertising burst in milliseconds. After the burst the interval requested by the
+     * accessory server is used.
+     *
+     * - If 0, kHAPPlatformBLEPeripheralManager_DefaultFastAdvertisingDuration is used.
+     */
+    HAPTime fastAdvertisingDuration;
+
+    /**
+     * Largest ATT MTU supported by the BLE stack. This value is offered to centrals during the MTU exchange.
+     *
+     * - If 0, kHAPPlatformBLEPeripheralManager_MaxATTMTU is used.
+     * - Must be between kHAPPlatformBLEPeripheralManager_DefaultATTMTU and kHAPPlatformBLEPeripheralManager_MaxATTMTU.
+     */
+    uint16_t maxATTMTU;
+
+    /**
+     * Largest LE Data Length supported by the BLE controller.
+     *
+     * - If 0, kHAPPlatformBLEPeripheralManager_MaxDataLength is used.
+     * - Must be between kHAPPlatformBLEPeripheralManager_DefaultDataLength and
+     *   kHAPPlatformBLEPeripheralManager_MaxDataLength.
+     */
+    uint16_t maxDataLength;
+
+    /**
+     * Callback to request new connection parameters from the BLE stack.
+     *
+     * - If NULL, connection parameters are left to the BLE stack.
+     */
+    HAPPlatformBLEPeripheralManagerUpdateConnectionParametersCallback _Nullable updateConnectionParameters;
+
+    /**
+     * Callback to hand a new advertising payload to the BLE stack.
+     *
+     * - If NULL, the BLE stack fetches the advertising payload using HAPPlatformBLEPeripheralManagerGetAdvertisingData.
+     */
+    HAPPlatformBLEPeripheralManagerUpdateAdvertisingDataCallback _Nullable updateAdvertisingData;
+
+    /**
+     * Callback to hand the advertising interval that is in effect to the BLE stack.
+     *
+     * - If NULL, fast advertising bursts have no effect and the BLE stack must start and stop advertising on its own.
+     */
+    HAPPlatformBLEPeripheralManagerUpdateAdvertisingIntervalCallback _Nullable updateAdvertisingInterval;
+
+    /**
+     * Context that is passed to the updateConnectionParameters, updateAdvertisingData and updateAdvertisingInterval
+     * callbacks.
+     */
+    void* _Nullable context;
+
+    /**
+     * Connection parameters requested while HAP-BLE procedures are active.
+     *
+     * - If NULL, kHAPPlatformBLEPeripheralManager_DefaultActiveConnectionParameters is used.
+     */
+    const HAPPlatformBLEPeripheralManagerConnectionParameters* _Nullable activeConnectionParameters;
+
+    /**
+     * Connection parameters requested after a quiet period.
+     *
+     * - If NULL, kHAPPlatformBLEPeripheralManager_DefaultIdleConnectionParameters is used.
+     */
+    const HAPPlatformBLEPeripheralManagerConnectionParameters* _Nullable idleConnectionParameters;
+
+    /**
+     * Time without GATT traffic after which the idle connection parameters are requested.
+     *
+     * - If 0, kHAPPlatformBLEPeripheralManager_DefaultQuietDuration is used.
+     */
+    HAPTime quietDuration;
 } HAPPlatformBLEPeripheralManagerOptions;
 
+/**
+ * Advertising payload.
+ */
+typedef struct {
+    uint8_t advertisingBytes[31];
+    uint8_t numAdvertisingBytes;
+    uint8_t scanResponseBytes[31];
+    uint8_t numScanResponseBytes;
+} HAPPlatformBLEPeripheralManagerAdvertisement;
+
 /**
  * BLE peripheral manager.
  */
@@ -83,20 +342,51 @@ struct HAPPlatformBLEPeripheralManager {
     /**@cond */
     HAPPlatformBLEPeripheralManagerAttribute* attributes;
     size_t numAttributes;
+    HAPPlatformKeyValueStoreRef _Nullable keyValueStore;
 
     HAPPlatformBLEPeripheralManagerDelegate delegate;
     HAPPlatformBLEPeripheralManagerDeviceAddress deviceAddress;
     char deviceName[64 + 1];
 
-    uint8_t advertisingBytes[31];
-    uint8_t numAdvertisingBytes;
-    uint8_t scanResponseBytes[31];
-    uint8_t numScanResponseBytes;
+    HAPPlatformBLEPeripheralManagerAdvertisement advertisements[2];
+    uint8_t advertisementIndex;
+    uint32_t numBroadcastNotifications;
     HAPBLEAdvertisingInterval advertisingInterval;
+    HAPBLEAdvertisingInterval preferredAdvertisingInterval;
+
+    HAPBLEAdvertisingInterval fastAdvertisingInterval;
+    HAPTime fastAdvertisingDuration;
+    HAPPlatformTimerRef fastAdvertisingTimer;
+    HAPTime advertisingStartTime;
+
+    HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle;
+
+    uint16_t maxATTMTU;
+    uint16_t maxDataLength;
+    uint16_t attMTU;
+    uint16_t dataLength;
+
+    HAPPlatformBLEPeripheralManagerUpdateConnectionParametersCallback _Nullable updateConnectionParameters;
+    HAPPlatformBLEPeripheralManagerUpdateAdvertisingDataCallback _Nullable updateAdvertisingData;
+    HAPPlatformBLEPeripheralManagerUpdateAdvertisingIntervalCallback _Nullable updateAdvertisingInterval;
+    void* _Nullable context;
+    HAPPlatformBLEPeripheralManagerConnectionParameters activeConnectionParameters;
+    HAPPlatformBLEPeripheralManagerConnectionParameters idleConnectionParameters;
+    HAPTime quietDuration;
+    HAPPlatformTimerRef quietTimer;
+    HAPTime regimeStartTime;
+    HAPTime procedureStartTime;
+    HAPPlatformBLEPeripheralManagerAttributeHandle procedureAttributeHandle;
+    HAPPlatformBLEPeripheralManagerStatistics statistics;
+
+    uint32_t gattDatabaseHash;
+    HAPPlatformBLEPeripheralManagerAttributeHandle lastAttributeHandle;
 
     bool isDeviceAddressSet : 1;
     bool didPublishAttributes : 1;
     bool isConnected : 1;
+    bool isServiceChangePending : 1;
+    bool isIdle : 1;
     /**@endcond */
 };
 
@@ -110,6 +400,169 @@ void HAPPlatformBLEPeripheralManagerCreate(
         HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
         const HAPPlatformBLEPeripheralManagerOptions* options);
 
+/**
+ * Informs the BLE peripheral manager that a central has connected.
+ *
+ * - This function is called by the BLE stack integration.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      connectionHandle     Connection handle of the connected central.
+ */
+void HAPPlatformBLEPeripheralManagerHandleCentralConnected(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle);
+
+/**
+ * Informs the BLE peripheral manager that a central has disconnected.
+ *
+ * - This function is called by the BLE stack integration.
+ * - Advertising resumes with a fast advertising burst so that controllers rediscover the accessory quickly.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      connectionHandle     Connection handle of the disconnected central.
+ */
+void HAPPlatformBLEPeripheralManagerHandleCentralDisconnected(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle);
+
+/**
+ * Handles an ATT MTU exchange request from the connected central.
+ *
+ * - This function is called by the BLE stack integration.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      connectionHandle     Connection handle of the connected central.
+ * @param      clientRxMTU          Client Rx MTU requested by the central.
+ *
+ * @return Server Rx MTU to send in the Exchange MTU Response.
+ */
+HAP_RESULT_USE_CHECK
+uint16_t HAPPlatformBLEPeripheralManagerHandleMTUExchange(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle,
+        uint16_t clientRxMTU);
+
+/**
+ * Informs the BLE peripheral manager that the LE Data Length of the connection changed.
+ *
+ * - This function is called by the BLE stack integration.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      connectionHandle     Connection handle of the connected central.
+ * @param      maxTxOctets          Maximum number of payload octets per link layer packet.
+ */
+void HAPPlatformBLEPeripheralManagerHandleDataLengthChange(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle,
+        uint16_t maxTxOctets);
+
+/**
+ * Returns the LE Data Length that should be requested from the central after a connection is established.
+ *
+ * - The BLE stack integration should start the Data Length Update Procedure with this value.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ *
+ * @return Maximum number of payload octets per link layer packet to request.
+ */
+HAP_RESULT_USE_CHECK
+uint16_t HAPPlatformBLEPeripheralManagerGetPreferredDataLength(HAPPlatformBLEPeripheralManagerRef blePeripheralManager);
+
+/**
+ * Returns the ATT MTU of the current connection.
+ *
+ * - If no central is connected, kHAPPlatformBLEPeripheralManager_DefaultATTMTU is returned.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ *
+ * @return ATT MTU of the current connection.
+ */
+HAP_RESULT_USE_CHECK
+uint16_t HAPPlatformBLEPeripheralManagerGetATTMTU(HAPPlatformBLEPeripheralManagerRef blePeripheralManager);
+
+/**
+ * Fetches connection statistics.
+ *
+ * - Statistics accumulate over all connections since the BLE peripheral manager was created.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param[out] statistics           Connection statistics.
+ */
+void HAPPlatformBLEPeripheralManagerGetStatistics(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerStatistics* statistics);
+
+/**
+ * Fetches the attribute handle range that controllers must rediscover, if any.
+ *
+ * - The GATT database layout is hashed when services are published and compared with the layout that was last
+ *   announced to controllers. The layout is remembered in the key-value store.
+ * - The BLE stack integration should call this function after a central connected and send a Service Changed
+ *   indication for the returned range if a change is pending. Once this function reported a change, the new
+ *   layout is considered announced.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param[out] startHandle          First affected attribute handle.
+ * @param[out] endHandle            Last affected attribute handle.
+ *
+ * @return true                     If the GATT database changed and a Service Changed indication should be sent.
+ * @return false                    Otherwise.
+ */
+HAP_RESULT_USE_CHECK
+bool HAPPlatformBLEPeripheralManagerTakePendingServiceChange(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerAttributeHandle* startHandle,
+        HAPPlatformBLEPeripheralManagerAttributeHandle* endHandle);
+
+/**
+ * Handles a GATT read request from the connected central.
+ *
+ * - This function is called by the BLE stack integration.
+ * - The read is limited to a single ATT_READ_RSP so that each HAP-BLE PDU fragment fills the negotiated MTU.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      connectionHandle     Connection handle of the connected central.
+ * @param      attributeHandle      Attribute handle that is read.
+ * @param[out] bytes                Buffer to fill with the attribute value.
+ * @param      maxBytes             Capacity of buffer.
+ * @param[out] numBytes             Length of data that was written to buffer.
+ *
+ * @return kHAPError_None           If successful.
+ * @return kHAPError_InvalidState   If the request is not allowed in the current state.
+ * @return kHAPError_OutOfResources If buffer not large enough.
+ */
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformBLEPeripheralManagerHandleReadRequest(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle,
+        HAPPlatformBLEPeripheralManagerAttributeHandle attributeHandle,
+        void* bytes,
+        size_t maxBytes,
+        size_t* numBytes);
+
+/**
+ * Handles a GATT write request from the connected central.
+ *
+ * - This function is called by the BLE stack integration.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      connectionHandle     Connection handle of the connected central.
+ * @param      attributeHandle      Attribute handle that is written.
+ * @param      bytes                Attribute value.
+ * @param      numBytes             Length of attribute value.
+ *
+ * @return kHAPError_None           If successful.
+ * @return kHAPError_InvalidState   If the request is not allowed in the current state.
+ * @return kHAPError_InvalidData    If the request contains invalid data.
+ */
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformBLEPeripheralManagerHandleWriteRequest(
+        HAPPlatformBLEPeripheralManagerRef blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle,
+        HAPPlatformBLEPeripheralManagerAttributeHandle attributeHandle,
+        void* bytes,
+        size_t numBytes);
+
 #if __has_feature(nullability)
 #pragma clang assume_nonnull end
 #endif
@@ -0,0 +1,98 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HAP_PLATFORM_BLE_SESSION_CACHE_INIT_H
+#define HAP_PLATFORM_BLE_SESSION_CACHE_INIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "HAP.h"
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull begin
+#endif
+
+/**@file
+ * HAP-BLE session cache that survives restarts.
+ *
+ * The session cache lets a controller resume a previous HAP-BLE session with Pair-Resume instead of running a full
+ * pair-verify (X25519, two Ed25519 operations and HKDF). It normally lives in RAM and is lost on every restart, so all
+ * controllers fall back to pair-verify at the same time after an update or a crash.
+ *
+ * Here the cache elements live in RTC memory that is not initialized on boot. A heartbeat timer records the wall clock
+ * while the accessory runs. On the next boot the cache is kept only if:
+ * - the chip was reset by software, a panic, a watchdog or deep sleep (power loss and brownout clear RTC memory), and
+ * - the accessory was running no longer than CONFIG_HAP_BLE_SESSION_CACHE_PERSIST_TIMEOUT seconds ago.
+ *
+ * Otherwise the cache starts out empty. HAP-IP has no session resumption, so only HAP-BLE benefits.
+ *
+ * - The wall clock of the ESP32 keeps counting across these resets, which makes the expiry check possible.
+ *
+ * - Cache entries are ranked by monotonic time, which restarts on boot. Restored entries therefore rank as recently
+ *   used until they are replaced.
+ *
+ * - The cache is only used by a HAP-BLE accessory server. The examples are built for HAP-IP only and there is no BLE
+ *   stack adapter yet (see HAPPlatformBLEPeripheralManager+Init.h), so it is not reachable in the shipped builds.
+ */
+
+/**
+ * Validates the session cache kept in RTC memory. Must be called once at startup.
+ *
+ * @return Number of session cache elements that were kept from before the restart.
+ */
+size_t HAPPlatformBLESessionCacheCreate(void);
+
+/**
+ * Returns the session cache elements to use for HAPBLEAccessoryServerStorage.
+ *
+ * @param[out] numElements          Number of session cache elements.
+ *
+ * @return Session cache elements in RTC memory.
+ */
+HAP_RESULT_USE_CHECK
+HAPBLESessionCacheElementRef* HAPPlatformBLESessionCacheGetElements(size_t* numElements);
+
+/**
+ * Restores the session cache that was kept from before the restart and starts the heartbeat.
+ *
+ * - The accessory server resets its storage when it is created, so this must be called after HAPAccessoryServerCreate.
+ *
+ * - Must be called from the run loop thread.
+ */
+void HAPPlatformBLESessionCacheRestore(void);
+
+/**
+ * Discards all cached sessions, in RTC memory and in the accessory server storage.
+ *
+ * - Must be called when pairings are removed outside of the accessory server, e.g. on factory reset.
+ */
+void HAPPlatformBLESessionCacheInvalidate(void);
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull end
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HAP_PLATFORM_CRYPTO_INIT_H
+#define HAP_PLATFORM_CRYPTO_INIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "HAPPlatform.h"
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull begin
+#endif
+
+/**@file
+ * Optimized crypto primitives.
+ *
+ * Selected ADK crypto functions are replaced at link time with optimized implementations (see the "Crypto" menu in
+ * menuconfig). Each replacement checks itself against a known answer test before first use.
+ */
+
+/**
+ * Cross-checks the optimized crypto primitives against the original implementations and logs their throughput.
+ *
+ * - Takes several hundred milliseconds on ESP32. Intended for bring-up and benchmarking.
+ */
+void HAPPlatformCryptoSelfTest(void);
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull end
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
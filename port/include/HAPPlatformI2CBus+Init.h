@@ -0,0 +1,226 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HAP_PLATFORM_I2C_BUS_INIT_H
+#define HAP_PLATFORM_I2C_BUS_INIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "HAPPlatform.h"
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull begin
+#endif
+
+/**@file
+ * Shared I2C bus.
+ *
+ * All devices on the bus (e.g. the Apple Authentication Coprocessor and application sensors) submit transactions to
+ * a queue that is served by a dedicated task. Pending transactions are started by priority and then by deadline.
+ * A device that is busy and NACKs is retried later without holding the bus, so other devices are served meanwhile.
+ *
+ * - Transactions may be submitted from any task. Completion callbacks are invoked on the run loop.
+ * - The run loop must be created before the first asynchronous transaction completes.
+ */
+
+/**
+ * Transaction priority.
+ */
+HAP_ENUM_BEGIN(uint8_t, HAPPlatformI2CBusPriority) {
+    /** Background work, e.g. periodic sensor sampling. */
+    kHAPPlatformI2CBusPriority_Low,
+
+    /** Default priority. */
+    kHAPPlatformI2CBusPriority_Normal,
+
+    /** Latency sensitive work, e.g. authentication during pairing. */
+    kHAPPlatformI2CBusPriority_High
+} HAP_ENUM_END(uint8_t, HAPPlatformI2CBusPriority);
+
+typedef struct HAPPlatformI2CBusTransaction HAPPlatformI2CBusTransaction;
+
+/**
+ * Transaction completion callback.
+ *
+ * - Called on the run loop.
+ *
+ * @param      transaction          Transaction that completed. May be submitted again from within the callback.
+ * @param      error                kHAPError_None           If successful.
+ *                                  kHAPError_Busy           If the deadline passed before the transaction started.
+ *                                  kHAPError_Unknown        If the device did not respond after all attempts.
+ * @param      context              Context that was set in the transaction.
+ */
+typedef void (*HAPPlatformI2CBusCompletionCallback)(
+        HAPPlatformI2CBusTransaction* transaction,
+        HAPError error,
+        void* _Nullable context);
+
+/**
+ * I2C transaction.
+ *
+ * The write phase and the read phase are issued as a single command link with a repeated start in between.
+ * Either phase may be omitted by setting its length to 0.
+ */
+struct HAPPlatformI2CBusTransaction {
+    /** 7-bit device address. */
+    uint8_t address;
+
+    /** Priority. */
+    HAPPlatformI2CBusPriority priority;
+
+    /** Maximum number of attempts. 0 is treated as 1. */
+    uint16_t maxAttempts;
+
+    /** Delay before retrying after a failed attempt in microseconds. */
+    uint32_t retryDelay;
+
+    /** Delay before the first attempt in microseconds, e.g. for a device to settle after the previous transaction. */
+    uint32_t startDelay;
+
+    /** Time by which the transaction must have started, or 0 if there is no deadline. */
+    HAPTime deadline;
+
+    /** Bytes to write. */
+    const void* _Nullable writeBytes;
+
+    /** Number of bytes to write. */
+    size_t numWriteBytes;
+
+    /** Buffer to read into. */
+    void* _Nullable readBytes;
+
+    /** Number of bytes to read. */
+    size_t numReadBytes;
+
+    /** Completion callback of an asynchronous transaction. */
+    HAPPlatformI2CBusCompletionCallback _Nullable callback;
+
+    /** Context that is passed to the completion callback. */
+    void* _Nullable context;
+
+    // Opaque fields. Do not access directly.
+    /**@cond */
+    HAPPlatformI2CBusTransaction* _Nullable next;
+    void* _Nullable completed;
+    uint64_t submitTime;
+    uint64_t notBefore;
+    uint16_t numAttempts;
+    HAPError error;
+    /**@endcond */
+};
+
+/**
+ * I2C bus initialization options.
+ */
+typedef struct {
+    /** GPIO for SDA. */
+    int sdaGPIO;
+
+    /** GPIO for SCL. */
+    int sclGPIO;
+
+    /** Clock speed in Hz. */
+    uint32_t clockSpeed;
+} HAPPlatformI2CBusOptions;
+
+/**
+ * I2C bus statistics.
+ */
+typedef struct {
+    /** Time since the bus was created in microseconds. */
+    uint64_t duration;
+
+    /** Time during which a transfer was in progress in microseconds. */
+    uint64_t busyDuration;
+
+    /** Number of completed transactions. */
+    uint32_t numTransactions;
+
+    /** Number of transactions that failed after all attempts. */
+    uint32_t numFailedTransactions;
+
+    /** Number of retried attempts. */
+    uint32_t numRetries;
+
+    /** Number of transactions that did not start before their deadline. */
+    uint32_t numMissedDeadlines;
+
+    /** Longest time from submission to completion of a transaction in microseconds. */
+    uint64_t maxLatency;
+} HAPPlatformI2CBusStatistics;
+
+/**
+ * Create I2C bus.
+ *
+ * @param      options              Initialization options.
+ */
+void HAPPlatformI2CBusCreate(const HAPPlatformI2CBusOptions* options);
+
+/**
+ * Release I2C bus.
+ *
+ * - No transactions may be pending.
+ */
+void HAPPlatformI2CBusRelease(void);
+
+/**
+ * Submits a transaction. The completion callback is invoked on the run loop.
+ *
+ * @param      transaction          Transaction with a completion callback. Must remain valid until completion.
+ */
+void HAPPlatformI2CBusSubmit(HAPPlatformI2CBusTransaction* transaction);
+
+/**
+ * Submits a transaction and blocks the calling task until it completes.
+ *
+ * - Other tasks keep running while the transaction is queued or retried.
+ *
+ * @param      transaction          Transaction without a completion callback.
+ *
+ * @return kHAPError_None           If successful.
+ * @return kHAPError_Busy           If the deadline passed before the transaction started.
+ * @return kHAPError_Unknown        If the device did not respond after all attempts.
+ */
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformI2CBusPerform(HAPPlatformI2CBusTransaction* transaction);
+
+/**
+ * Gets bus utilization statistics.
+ *
+ * @param[out] statistics           Statistics.
+ */
+void HAPPlatformI2CBusGetStatistics(HAPPlatformI2CBusStatistics* statistics);
+
+/**
+ * Logs bus utilization statistics.
+ */
+void HAPPlatformI2CBusLogStatistics(void);
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull end
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
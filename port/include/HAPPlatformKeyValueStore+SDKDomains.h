@@ -71,6 +71,26 @@ extern "C" {
  */
 #define kSDKKeyValueStoreKey_Provisioning_MFiToken ((HAPPlatformKeyValueStoreKey) 0x21)
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * BLE peripheral manager state.
+ *
+ * Purged: Never.
+ */
+#define kSDKKeyValueStoreDomain_BLEPeripheralManager ((HAPPlatformKeyValueStoreDomain) 0x41)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Layout of the GATT database that was last announced to controllers.
+ *
+ * Format:
+ * - UInt32LE: Hash of the attribute layout (types, properties and handles).
+ * - UInt16LE: Last used attribute handle.
+ */
+#define kSDKKeyValueStoreKey_BLEPeripheralManager_GATTDatabase ((HAPPlatformKeyValueStoreKey) 0x01)
+
 #ifdef __cplusplus
 }
 #endif
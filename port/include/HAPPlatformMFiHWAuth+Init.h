@@ -25,20 +25,78 @@
 extern "C" {
 #endif
 
+#if defined(ESP_PLATFORM)
+#include <sdkconfig.h>
+#endif
+
 #include "HAPPlatform.h"
 
 #if __has_feature(nullability)
 #pragma clang assume_nonnull begin
 #endif
 
+#if !CONFIG_HAP_MFI_HW_AUTH_EMULATOR
+/**
+ * Number of coprocessor registers whose contents never change and are served from RAM after the first read.
+ *
+ * - Device Version, Authentication Revision, Protocol Major / Minor Version and Device ID (0x00 - 0x04).
+ * - Accessory Certificate Data Length and Accessory Certificate Data 1 - 10 (0x30 - 0x3A).
+ */
+#define kHAPPlatformMFiHWAuth_NumStaticRegisters ((size_t) 16)
+
+/**
+ * Number of bytes reserved for the contents of the static coprocessor registers.
+ */
+#define kHAPPlatformMFiHWAuth_NumStaticRegisterBytes ((size_t)(1 + 1 + 1 + 1 + 4 + 2 + 10 * 128))
+#endif
+
+#if CONFIG_HAP_MFI_HW_AUTH_EMULATOR
+/**
+ * Timing model of the Apple Authentication Coprocessor emulator.
+ */
+typedef struct {
+    /** I2C clock speed in Hz. Each transferred byte costs 9 clock cycles. */
+    uint32_t clockSpeed;
+
+    /** Fixed cost of each transaction (start, address, stop and driver overhead) in microseconds. */
+    uint32_t transactionDuration;
+
+    /** Time to generate a challenge response in microseconds. The coprocessor is busy meanwhile. */
+    uint32_t signatureDuration;
+} HAPPlatformMFiHWAuthEmulatorLatencyModel;
+#endif
+
 /**
  * Apple Authentication Coprocessor provider.
  */
 struct HAPPlatformMFiHWAuth {
     // Opaque type. Do not access the instance fields directly.
     /**@cond */
-    uint8_t slaveAddr;
     bool poweredOn;
+
+    uint64_t powerOnTime;
+    uint32_t numTransactions;
+    uint64_t transactionDuration;
+
+#if CONFIG_HAP_MFI_HW_AUTH_EMULATOR
+    // Coprocessor emulator.
+    HAPPlatformMFiHWAuthEmulatorLatencyModel latencyModel;
+    uint64_t busyUntil;
+    uint16_t numChallengeBytes;
+    uint8_t challengeBytes[32];
+    uint8_t signatureBytes[64];
+    uint8_t status;
+    uint8_t errorCode;
+#else
+    // I2C driver.
+    uint8_t slaveAddr;
+    uint32_t startDelay;
+    uint8_t staticRegisterBytes[kHAPPlatformMFiHWAuth_NumStaticRegisterBytes];
+    uint8_t numStaticRegisterBytes[kHAPPlatformMFiHWAuth_NumStaticRegisters];
+    uint32_t staticRegisterDurations[kHAPPlatformMFiHWAuth_NumStaticRegisters];
+    uint32_t numCacheHits;
+    uint64_t cacheDuration;
+#endif
     /**@endcond */
 };
 
@@ -56,6 +114,18 @@ void HAPPlatformMFiHWAuthCreate(HAPPlatformMFiHWAuthRef mfiHWAuth);
  */
 void HAPPlatformMFiHWAuthRelease(HAPPlatformMFiHWAuthRef mfiHWAuth);
 
+#if CONFIG_HAP_MFI_HW_AUTH_EMULATOR
+/**
+ * Changes the timing model of the Apple Authentication Coprocessor emulator.
+ *
+ * @param      mfiHWAuth            Apple Authentication Coprocessor provider.
+ * @param      latencyModel         Timing model.
+ */
+void HAPPlatformMFiHWAuthEmulatorSetLatencyModel(
+        HAPPlatformMFiHWAuthRef mfiHWAuth,
+        const HAPPlatformMFiHWAuthEmulatorLatencyModel* latencyModel);
+#endif
+
 #if __has_feature(nullability)
 #pragma clang assume_nonnull end
 #endif
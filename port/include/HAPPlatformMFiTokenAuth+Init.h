@@ -73,6 +73,14 @@ struct HAPPlatformMFiTokenAuth {
     // Opaque type. Do not access the instance fields directly.
     /**@cond */
     HAPPlatformKeyValueStoreRef keyValueStore;
+
+    // Provisioning data is served from RAM after the first load. HAPPlatformMFiTokenAuthUpdate writes through.
+    HAPPlatformMFiTokenAuthUUID mfiTokenUUID;
+    uint8_t mfiTokenBytes[kHAPPlatformMFiTokenAuth_MaxMFiTokenBytes];
+    size_t numMFiTokenBytes;
+    bool isCached : 1;
+    bool foundMFiTokenUUID : 1;
+    bool foundMFiToken : 1;
     /**@endcond */
 };
 
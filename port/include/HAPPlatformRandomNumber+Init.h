@@ -0,0 +1,62 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HAP_PLATFORM_RANDOM_NUMBER_INIT_H
+#define HAP_PLATFORM_RANDOM_NUMBER_INIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "HAPPlatform.h"
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull begin
+#endif
+
+/**@file
+ * Random number generator.
+ *
+ * HAPPlatformRandomNumberFill serves output from a ChaCha20 based generator that is seeded with system entropy.
+ *
+ * - On ESP32 the hardware RNG only produces true random numbers while the RF subsystem (Wi-Fi or BT) or the
+ *   bootloader random source is enabled. The initial seed is therefore drawn by HAPPlatformRandomNumberCreate with
+ *   the bootloader random source enabled, and the generator refuses to produce output before that.
+ * - The key is mixed with fresh system entropy at least every few seconds while the generator is in use.
+ */
+
+/**
+ * Seeds the random number generator.
+ *
+ * - Must be called before HAPPlatformRandomNumberFill.
+ * - On ESP32 this must be called before Wi-Fi or Bluetooth is started, and before the SAR ADC or I2S is used.
+ *   The bootloader random source is enabled while the seed is drawn and shares these peripherals.
+ */
+void HAPPlatformRandomNumberCreate(void);
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull end
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HAP_PLATFORM_TRANSPORT_ARENA_INIT_H
+#define HAP_PLATFORM_TRANSPORT_ARENA_INIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "HAPPlatform.h"
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull begin
+#endif
+
+/**@file
+ * Shared memory budget for the IP and BLE transports.
+ *
+ * The accessory server storage of both transports is carved from a single buffer so that a dual-transport build is
+ * bounded by one compile-time cap instead of the sum of two worst cases. The accessory server keeps its storage for
+ * its whole lifetime, so memory is handed out once during initialization and never returned.
+ */
+
+/**
+ * Transport that borrows memory from the arena.
+ */
+HAP_ENUM_BEGIN(uint8_t, HAPPlatformTransportArenaUser) {
+    /** IP transport. */
+    kHAPPlatformTransportArenaUser_IP,
+
+    /** BLE transport. */
+    kHAPPlatformTransportArenaUser_BLE
+} HAP_ENUM_END(uint8_t, HAPPlatformTransportArenaUser);
+
+/**
+ * Transport arena initialization options.
+ */
+typedef struct {
+    /**
+     * Buffer to carve transport storage from.
+     */
+    void* bytes;
+
+    /**
+     * Length of buffer.
+     */
+    size_t numBytes;
+} HAPPlatformTransportArenaOptions;
+
+/**
+ * Transport arena.
+ */
+typedef struct {
+    // Opaque type. Do not access the instance fields directly.
+    /**@cond */
+    uint8_t* bytes;
+    size_t numBytes;
+    size_t numUsedBytes;
+    size_t numUserBytes[2];
+    /**@endcond */
+} HAPPlatformTransportArena;
+
+/**
+ * Initializes a transport arena.
+ *
+ * @param[out] arena                Pointer to an allocated but uninitialized HAPPlatformTransportArena structure.
+ * @param      options              Initialization options.
+ */
+void HAPPlatformTransportArenaCreate(HAPPlatformTransportArena* arena, const HAPPlatformTransportArenaOptions* options);
+
+/**
+ * Borrows zero-initialized memory from the arena.
+ *
+ * @param      arena                Transport arena.
+ * @param      user                 Transport that borrows the memory.
+ * @param      numBytes             Number of bytes to borrow.
+ *
+ * @return Pointer to suitably aligned memory, or NULL if the arena does not have enough space left.
+ */
+HAP_RESULT_USE_CHECK
+void* _Nullable HAPPlatformTransportArenaAllocate(
+        HAPPlatformTransportArena* arena,
+        HAPPlatformTransportArenaUser user,
+        size_t numBytes);
+
+/**
+ * Returns the number of bytes that can still be borrowed from the arena.
+ *
+ * - Alignment padding of the next allocation is not accounted for.
+ *
+ * @param      arena                Transport arena.
+ *
+ * @return Number of free bytes.
+ */
+HAP_RESULT_USE_CHECK
+size_t HAPPlatformTransportArenaGetNumFreeBytes(const HAPPlatformTransportArena* arena);
+
+/**
+ * Logs how much of the arena each transport uses.
+ *
+ * @param      arena                Transport arena.
+ */
+void HAPPlatformTransportArenaLogUsage(const HAPPlatformTransportArena* arena);
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull end
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HAP_PLATFORM_WALL_CLOCK_INIT_H
+#define HAP_PLATFORM_WALL_CLOCK_INIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "HAPPlatform.h"
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull begin
+#endif
+
+/**@file
+ * Global mapping between the monotonic clock and UTC.
+ *
+ * The offset between HAPPlatformClockGetCurrent and the system wall clock is kept so that calendar-aligned deadlines
+ * can be computed without libc time conversions. When the wall clock is set (e.g. by SNTP), the offset is updated and
+ * observers are informed on the run loop.
+ *
+ * - The run loop must be created before the wall clock.
+ * - On ESP32 the SNTP time synchronization notification is used to detect wall clock changes.
+ */
+
+/**
+ * Wall clock change callback.
+ *
+ * - Called on the run loop.
+ * - The callback may add or remove observers, including its own. Observers added from within the callback are
+ *   first informed about the next adjustment.
+ *
+ * @param      context              Context that was passed when the observer was added.
+ * @param      adjustment           Amount by which the wall clock moved relative to the monotonic clock in milliseconds.
+ *                                  Negative if the wall clock moved backwards.
+ */
+typedef void (*HAPPlatformWallClockObserverCallback)(void* _Nullable context, int64_t adjustment);
+
+/**
+ * Wall clock observer.
+ */
+typedef struct HAPPlatformWallClockObserver HAPPlatformWallClockObserver;
+struct HAPPlatformWallClockObserver {
+    // Opaque type. Do not access the instance fields directly.
+    /**@cond */
+    HAPPlatformWallClockObserverCallback callback;
+    void* _Nullable context;
+    HAPPlatformWallClockObserver* _Nullable next;
+    /**@endcond */
+};
+
+/**
+ * Create wall clock.
+ */
+void HAPPlatformWallClockCreate(void);
+
+/**
+ * Release wall clock.
+ */
+void HAPPlatformWallClockRelease(void);
+
+/**
+ * Returns whether the wall clock has been set since boot.
+ *
+ * @return true                     If the wall clock has been synchronized.
+ * @return false                    Otherwise.
+ */
+HAP_RESULT_USE_CHECK
+bool HAPPlatformWallClockIsSynchronized(void);
+
+/**
+ * Gets the current UTC time.
+ *
+ * @return Milliseconds since 1970-01-01 00:00:00 UTC.
+ */
+HAP_RESULT_USE_CHECK
+int64_t HAPPlatformWallClockGetCurrent(void);
+
+/**
+ * Converts a monotonic time to UTC.
+ *
+ * @param      time                 Time as returned by HAPPlatformClockGetCurrent.
+ *
+ * @return Milliseconds since 1970-01-01 00:00:00 UTC.
+ */
+HAP_RESULT_USE_CHECK
+int64_t HAPPlatformWallClockGetUTCFromTime(HAPTime time);
+
+/**
+ * Computes the next calendar-aligned boundary as a monotonic deadline.
+ *
+ * - The boundary is the next UTC time after now for which (UTC - phase) is a multiple of period.
+ *   For example, period = 1 h and phase = 15 min yields the next quarter past the hour.
+ * - The result may be passed directly to HAPPlatformTimerRegister. Observers should recompute deadlines when
+ *   the wall clock changes.
+ * - The result is always greater than now, so (result - now) is the delay until the boundary. Pass the same now
+ *   that is subtracted instead of reading the clock again.
+ *
+ * @param      now                  Current time as returned by HAPPlatformClockGetCurrent.
+ * @param      period               Period in milliseconds.
+ * @param      phase                Phase within the period in milliseconds. Must be less than period.
+ *
+ * @return Deadline in the time base of HAPPlatformClockGetCurrent.
+ */
+HAP_RESULT_USE_CHECK
+HAPTime HAPPlatformWallClockGetNextBoundary(HAPTime now, HAPTime period, HAPTime phase);
+
+/**
+ * Starts informing an observer about wall clock changes.
+ *
+ * @param[out] observer             Observer. Must remain valid until removed.
+ * @param      callback             Function to call when the wall clock changed.
+ * @param      context              Context that is passed to the callback.
+ */
+void HAPPlatformWallClockAddObserver(
+        HAPPlatformWallClockObserver* observer,
+        HAPPlatformWallClockObserverCallback callback,
+        void* _Nullable context);
+
+/**
+ * Stops informing an observer about wall clock changes.
+ *
+ * @param      observer             Observer.
+ */
+void HAPPlatformWallClockRemoveObserver(HAPPlatformWallClockObserver* observer);
+
+/**
+ * Informs the wall clock that the system time may have been set.
+ *
+ * - May be called from any thread except the lwIP thread (e.g. from SNTP callbacks), because scheduling the update
+ *   on the run loop uses a loopback socket. Observers are informed on the run loop.
+ * - On ESP32 this is done automatically after SNTP synchronization, deferred to the esp_timer task.
+ * - If the update cannot be scheduled, an error is logged and observers are not informed.
+ */
+void HAPPlatformWallClockHandleTimeChanged(void);
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull end
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
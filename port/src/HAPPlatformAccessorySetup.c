@@ -44,28 +44,32 @@ void HAPPlatformAccessorySetupLoadSetupInfo(HAPPlatformAccessorySetupRef accesso
 
     HAPError err;
 
-    bool found;
-    size_t numBytes;
-    err = HAPPlatformKeyValueStoreGet(
-            accessorySetup->keyValueStore,
-            kSDKKeyValueStoreDomain_Provisioning,
-            kSDKKeyValueStoreKey_Provisioning_SetupInfo,
-            setupInfo,
-            sizeof *setupInfo,
-            &numBytes,
-            &found);
-    if (err) {
-        HAPAssert(err == kHAPError_Unknown);
-        HAPFatalError();
-    }
-    if (!found) {
-        HAPLogError(&logObject, "No setup code found in key-value store.");
-        HAPFatalError();
-    }
-    if (numBytes != sizeof *setupInfo) {
-        HAPLogError(&logObject, "Invalid setup code size %zu.", numBytes);
-        HAPFatalError();
+    if (!accessorySetup->setupInfoIsCached) {
+        bool found;
+        size_t numBytes;
+        err = HAPPlatformKeyValueStoreGet(
+                accessorySetup->keyValueStore,
+                kSDKKeyValueStoreDomain_Provisioning,
+                kSDKKeyValueStoreKey_Provisioning_SetupInfo,
+                &accessorySetup->setupInfo,
+                sizeof accessorySetup->setupInfo,
+                &numBytes,
+                &found);
+        if (err) {
+            HAPAssert(err == kHAPError_Unknown);
+            HAPFatalError();
+        }
+        if (!found) {
+            HAPLogError(&logObject, "No setup code found in key-value store.");
+            HAPFatalError();
+        }
+        if (numBytes != sizeof accessorySetup->setupInfo) {
+            HAPLogError(&logObject, "Invalid setup code size %zu.", numBytes);
+            HAPFatalError();
+        }
+        accessorySetup->setupInfoIsCached = true;
     }
+    HAPRawBufferCopyBytes(setupInfo, &accessorySetup->setupInfo, sizeof *setupInfo);
 }
 
 void HAPPlatformAccessorySetupLoadSetupCode(HAPPlatformAccessorySetupRef accessorySetup, HAPSetupCode* setupCode) {
@@ -74,28 +78,32 @@ void HAPPlatformAccessorySetupLoadSetupCode(HAPPlatformAccessorySetupRef accesso
 
     HAPError err;
 
-    bool found;
-    size_t numBytes;
-    err = HAPPlatformKeyValueStoreGet(
-            accessorySetup->keyValueStore,
-            kSDKKeyValueStoreDomain_Provisioning,
-            kSDKKeyValueStoreKey_Provisioning_SetupCode,
-            setupCode,
-            sizeof *setupCode,
-            &numBytes,
-            &found);
-    if (err) {
-        HAPAssert(err == kHAPError_Unknown);
-        HAPFatalError();
-    }
-    if (!found) {
-        HAPLogError(&logObject, "No setup code found in key-value store.");
-        HAPFatalError();
-    }
-    if (numBytes != sizeof *setupCode) {
-        HAPLogError(&logObject, "Invalid setup code size %zu.", numBytes);
-        HAPFatalError();
+    if (!accessorySetup->setupCodeIsCached) {
+        bool found;
+        size_t numBytes;
+        err = HAPPlatformKeyValueStoreGet(
+                accessorySetup->keyValueStore,
+                kSDKKeyValueStoreDomain_Provisioning,
+                kSDKKeyValueStoreKey_Provisioning_SetupCode,
+                &accessorySetup->setupCode,
+                sizeof accessorySetup->setupCode,
+                &numBytes,
+                &found);
+        if (err) {
+            HAPAssert(err == kHAPError_Unknown);
+            HAPFatalError();
+        }
+        if (!found) {
+            HAPLogError(&logObject, "No setup code found in key-value store.");
+            HAPFatalError();
+        }
+        if (numBytes != sizeof accessorySetup->setupCode) {
+            HAPLogError(&logObject, "Invalid setup code size %zu.", numBytes);
+            HAPFatalError();
+        }
+        accessorySetup->setupCodeIsCached = true;
     }
+    HAPRawBufferCopyBytes(setupCode, &accessorySetup->setupCode, sizeof *setupCode);
 }
 
 void HAPPlatformAccessorySetupLoadSetupID(
@@ -108,26 +116,33 @@ void HAPPlatformAccessorySetupLoadSetupID(
 
     HAPError err;
 
-    size_t numBytes;
-    err = HAPPlatformKeyValueStoreGet(
-            accessorySetup->keyValueStore,
-            kSDKKeyValueStoreDomain_Provisioning,
-            kSDKKeyValueStoreKey_Provisioning_SetupID,
-            setupID,
-            sizeof *setupID,
-            &numBytes,
-            valid);
-    if (err) {
-        HAPAssert(err == kHAPError_Unknown);
-        HAPFatalError();
-    }
-    if (!*valid) {
-        HAPLog(&logObject, "No setup ID found. QR codes and NFC require provisioning a setup ID.");
-        return;
+    if (!accessorySetup->setupIDIsCached) {
+        bool found;
+        size_t numBytes;
+        err = HAPPlatformKeyValueStoreGet(
+                accessorySetup->keyValueStore,
+                kSDKKeyValueStoreDomain_Provisioning,
+                kSDKKeyValueStoreKey_Provisioning_SetupID,
+                &accessorySetup->setupID,
+                sizeof accessorySetup->setupID,
+                &numBytes,
+                &found);
+        if (err) {
+            HAPAssert(err == kHAPError_Unknown);
+            HAPFatalError();
+        }
+        if (!found) {
+            HAPLog(&logObject, "No setup ID found. QR codes and NFC require provisioning a setup ID.");
+        } else if (numBytes != sizeof accessorySetup->setupID) {
+            HAPLogError(&logObject, "Invalid setup ID size %zu.", numBytes);
+            HAPFatalError();
+        }
+        accessorySetup->setupIDIsValid = found;
+        accessorySetup->setupIDIsCached = true;
     }
-    if (numBytes != sizeof *setupID) {
-        HAPLogError(&logObject, "Invalid setup ID size %zu.", numBytes);
-        HAPFatalError();
+    *valid = accessorySetup->setupIDIsValid;
+    if (*valid) {
+        HAPRawBufferCopyBytes(setupID, &accessorySetup->setupID, sizeof *setupID);
     }
 }
 
@@ -19,6 +19,7 @@
 // limitations under the License.
 
 #include "HAPPlatformBLEPeripheralManager+Init.h"
+#include "HAPPlatformKeyValueStore+SDKDomains.h"
 
 static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "BLEPeripheralManager" };
 
@@ -35,6 +36,38 @@ void HAPPlatformBLEPeripheralManagerCreate(
     HAPRawBufferZero(blePeripheralManager, sizeof *blePeripheralManager);
     blePeripheralManager->attributes = options->attributes;
     blePeripheralManager->numAttributes = options->numAttributes;
+    blePeripheralManager->keyValueStore = options->keyValueStore;
+    blePeripheralManager->fastAdvertisingInterval = options->fastAdvertisingInterval ?
+                                                            options->fastAdvertisingInterval :
+                                                            kHAPPlatformBLEPeripheralManager_DefaultFastAdvertisingInterval;
+    blePeripheralManager->fastAdvertisingDuration = options->fastAdvertisingDuration ?
+                                                            options->fastAdvertisingDuration :
+                                                            kHAPPlatformBLEPeripheralManager_DefaultFastAdvertisingDuration;
+
+    HAPPrecondition(!options->maxATTMTU || options->maxATTMTU >= kHAPPlatformBLEPeripheralManager_DefaultATTMTU);
+    HAPPrecondition(options->maxATTMTU <= kHAPPlatformBLEPeripheralManager_MaxATTMTU);
+    HAPPrecondition(
+            !options->maxDataLength || options->maxDataLength >= kHAPPlatformBLEPeripheralManager_DefaultDataLength);
+    HAPPrecondition(options->maxDataLength <= kHAPPlatformBLEPeripheralManager_MaxDataLength);
+    blePeripheralManager->maxATTMTU =
+            options->maxATTMTU ? options->maxATTMTU : kHAPPlatformBLEPeripheralManager_MaxATTMTU;
+    blePeripheralManager->maxDataLength =
+            options->maxDataLength ? options->maxDataLength : kHAPPlatformBLEPeripheralManager_MaxDataLength;
+    blePeripheralManager->attMTU = kHAPPlatformBLEPeripheralManager_DefaultATTMTU;
+    blePeripheralManager->dataLength = kHAPPlatformBLEPeripheralManager_DefaultDataLength;
+
+    blePeripheralManager->updateConnectionParameters = options->updateConnectionParameters;
+    blePeripheralManager->updateAdvertisingData = options->updateAdvertisingData;
+    blePeripheralManager->updateAdvertisingInterval = options->updateAdvertisingInterval;
+    blePeripheralManager->context = options->context;
+    blePeripheralManager->activeConnectionParameters =
+            options->activeConnectionParameters ? *options->activeConnectionParameters :
+                                                  kHAPPlatformBLEPeripheralManager_DefaultActiveConnectionParameters;
+    blePeripheralManager->idleConnectionParameters =
+            options->idleConnectionParameters ? *options->idleConnectionParameters :
+                                                kHAPPlatformBLEPeripheralManager_DefaultIdleConnectionParameters;
+    blePeripheralManager->quietDuration =
+            options->quietDuration ? options->quietDuration : kHAPPlatformBLEPeripheralManager_DefaultQuietDuration;
 }
 
 void HAPPlatformBLEPeripheralManagerSetDelegate(
@@ -317,9 +350,229 @@ void HAPPlatformBLEPeripheralManagerPublishServices(HAPPlatformBLEPeripheralMana
     HAPPrecondition(blePeripheralManager->isDeviceAddressSet);
     HAPPrecondition(!blePeripheralManager->didPublishAttributes);
 
+    // Attributes are zeroed before they are filled in, so their raw bytes (including padding) are deterministic.
+    // Handles are assigned sequentially, so the same services added in the same order yield the same handles.
+    uint32_t hash = 2166136261U; // FNV-1a.
+    HAPPlatformBLEPeripheralManagerAttributeHandle lastAttributeHandle = 0;
+    for (size_t i = 0; i < blePeripheralManager->numAttributes; i++) {
+        const HAPPlatformBLEPeripheralManagerAttribute* attribute = &blePeripheralManager->attributes[i];
+        if (attribute->type == kHAPPlatformBLEPeripheralManagerAttributeType_None) {
+            break;
+        }
+        const uint8_t* bytes = (const uint8_t*) attribute;
+        for (size_t j = 0; j < sizeof *attribute; j++) {
+            hash ^= bytes[j];
+            hash *= 16777619U;
+        }
+        switch (attribute->type) {
+            case kHAPPlatformBLEPeripheralManagerAttributeType_None: {
+                HAPFatalError();
+            }
+            case kHAPPlatformBLEPeripheralManagerAttributeType_Service: {
+                lastAttributeHandle = attribute->_.service.handle;
+            } break;
+            case kHAPPlatformBLEPeripheralManagerAttributeType_Characteristic: {
+                lastAttributeHandle = attribute->_.characteristic.cccDescriptorHandle ?
+                                              attribute->_.characteristic.cccDescriptorHandle :
+                                              attribute->_.characteristic.valueHandle;
+            } break;
+            case kHAPPlatformBLEPeripheralManagerAttributeType_Descriptor: {
+                lastAttributeHandle = attribute->_.descriptor.handle;
+            } break;
+        }
+    }
+    blePeripheralManager->gattDatabaseHash = hash;
+    blePeripheralManager->lastAttributeHandle = lastAttributeHandle;
+
+    uint8_t bytes[sizeof(uint32_t) + sizeof(uint16_t)];
+    bool found = false;
+    if (blePeripheralManager->keyValueStore) {
+        HAPError err;
+        size_t numBytes;
+        err = HAPPlatformKeyValueStoreGet(
+                HAPNonnull(blePeripheralManager->keyValueStore),
+                kSDKKeyValueStoreDomain_BLEPeripheralManager,
+                kSDKKeyValueStoreKey_BLEPeripheralManager_GATTDatabase,
+                bytes,
+                sizeof bytes,
+                &numBytes,
+                &found);
+        if (err) {
+            HAPAssert(err == kHAPError_Unknown);
+            HAPLog(&logObject, "Failed to read stored GATT database layout.");
+            found = false;
+        } else if (found && numBytes != sizeof bytes) {
+            HAPLog(&logObject, "Stored GATT database layout has invalid length (%zu).", numBytes);
+            found = false;
+        }
+    }
+    bool isChanged = true;
+    if (found) {
+        uint32_t storedHash = (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 |
+                              (uint32_t) bytes[3] << 24;
+        uint16_t storedLastAttributeHandle = (uint16_t)(bytes[4] | bytes[5] << 8);
+        isChanged = storedHash != hash || storedLastAttributeHandle != lastAttributeHandle;
+    }
+    // The stored layout is only updated once the change has been announced, so that a reboot before the Service
+    // Changed indication is sent does not lose it.
+    blePeripheralManager->isServiceChangePending = isChanged;
+    HAPLogInfo(
+            &logObject,
+            "GATT database: %u handles, hash 0x%08lX (%s).",
+            lastAttributeHandle,
+            (unsigned long) hash,
+            isChanged ? "changed" : "unchanged");
+
     blePeripheralManager->didPublishAttributes = true;
 }
 
+HAP_RESULT_USE_CHECK
+bool HAPPlatformBLEPeripheralManagerTakePendingServiceChange(
+        HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerAttributeHandle* _Nonnull startHandle,
+        HAPPlatformBLEPeripheralManagerAttributeHandle* _Nonnull endHandle) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->didPublishAttributes);
+    HAPPrecondition(startHandle);
+    HAPPrecondition(endHandle);
+
+    if (!blePeripheralManager->isServiceChangePending) {
+        return false;
+    }
+    blePeripheralManager->isServiceChangePending = false;
+
+    if (blePeripheralManager->keyValueStore) {
+        uint32_t hash = blePeripheralManager->gattDatabaseHash;
+        HAPPlatformBLEPeripheralManagerAttributeHandle lastAttributeHandle = blePeripheralManager->lastAttributeHandle;
+        uint8_t bytes[] = { (uint8_t)(hash & 0xFFU),
+                            (uint8_t)(hash >> 8 & 0xFFU),
+                            (uint8_t)(hash >> 16 & 0xFFU),
+                            (uint8_t)(hash >> 24 & 0xFFU),
+                            (uint8_t)(lastAttributeHandle & 0xFFU),
+                            (uint8_t)(lastAttributeHandle >> 8 & 0xFFU) };
+        HAPError err = HAPPlatformKeyValueStoreSet(
+                HAPNonnull(blePeripheralManager->keyValueStore),
+                kSDKKeyValueStoreDomain_BLEPeripheralManager,
+                kSDKKeyValueStoreKey_BLEPeripheralManager_GATTDatabase,
+                bytes,
+                sizeof bytes);
+        if (err) {
+            HAPAssert(err == kHAPError_Unknown);
+            HAPLog(&logObject, "Failed to store GATT database layout.");
+        }
+    }
+
+    // The whole database is reported because it was rebuilt from scratch.
+    *startHandle = 0x0001;
+    *endHandle = 0xFFFF;
+    return true;
+}
+
+/**
+ * Applies the advertising interval that is currently in effect.
+ *
+ * - During a fast advertising burst the shorter of the fast and the preferred advertising interval is used.
+ *   Otherwise, the preferred advertising interval requested by the accessory server is used.
+ *
+ * - The BLE stack is informed through the updateAdvertisingInterval callback when the interval changes.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ */
+static void UpdateAdvertisingInterval(HAPPlatformBLEPeripheralManagerRef blePeripheralManager) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->preferredAdvertisingInterval);
+
+    HAPBLEAdvertisingInterval advertisingInterval = blePeripheralManager->preferredAdvertisingInterval;
+    if (blePeripheralManager->fastAdvertisingTimer &&
+        blePeripheralManager->fastAdvertisingInterval < advertisingInterval) {
+        advertisingInterval = blePeripheralManager->fastAdvertisingInterval;
+    }
+    if (advertisingInterval == blePeripheralManager->advertisingInterval) {
+        return;
+    }
+
+    HAPLogDebug(
+            &logObject,
+            "Advertising interval: %u (0.625 ms units)%s.",
+            advertisingInterval,
+            blePeripheralManager->fastAdvertisingTimer ? " (fast advertising)" : "");
+    blePeripheralManager->advertisingInterval = advertisingInterval;
+    if (blePeripheralManager->updateAdvertisingInterval) {
+        blePeripheralManager->updateAdvertisingInterval(
+                blePeripheralManager, advertisingInterval, blePeripheralManager->context);
+    }
+}
+
+static void FastAdvertisingTimerExpired(HAPPlatformTimerRef timer, void* _Nullable context) {
+    HAPPrecondition(context);
+    HAPPlatformBLEPeripheralManagerRef blePeripheralManager = context;
+    HAPPrecondition(timer == blePeripheralManager->fastAdvertisingTimer);
+    blePeripheralManager->fastAdvertisingTimer = 0;
+
+    if (HAPPlatformBLEPeripheralManagerIsAdvertising(blePeripheralManager)) {
+        UpdateAdvertisingInterval(blePeripheralManager);
+    }
+}
+
+/**
+ * Starts or extends a fast advertising burst.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ */
+static void StartFastAdvertising(HAPPlatformBLEPeripheralManagerRef blePeripheralManager) {
+    HAPPrecondition(blePeripheralManager);
+
+    HAPError err;
+
+    if (blePeripheralManager->fastAdvertisingTimer) {
+        HAPPlatformTimerDeregister(blePeripheralManager->fastAdvertisingTimer);
+        blePeripheralManager->fastAdvertisingTimer = 0;
+    }
+    err = HAPPlatformTimerRegister(
+            &blePeripheralManager->fastAdvertisingTimer,
+            HAPPlatformClockGetCurrent() + blePeripheralManager->fastAdvertisingDuration,
+            FastAdvertisingTimerExpired,
+            blePeripheralManager);
+    if (err) {
+        HAPAssert(err == kHAPError_OutOfResources);
+        HAPLog(&logObject, "Not enough resources to start fast advertising. Using preferred advertising interval.");
+        blePeripheralManager->fastAdvertisingTimer = 0;
+    }
+}
+
+/**
+ * Checks whether advertising data carries a HAP-BLE encrypted broadcast notification.
+ *
+ * @see HomeKit Accessory Protocol Specification R14
+ *      Section 7.4.6.2 Broadcasted Events
+ *
+ * @param      bytes                Advertising data.
+ * @param      numBytes             Length of advertising data.
+ *
+ * @return true                     If the advertising data is a broadcast notification.
+ * @return false                    Otherwise.
+ */
+HAP_RESULT_USE_CHECK
+static bool IsBroadcastNotification(const uint8_t* bytes, size_t numBytes) {
+    HAPPrecondition(bytes);
+
+    // Walk the AD structures looking for Manufacturer Specific Data (0xFF) with the Apple company identifier (0x004C)
+    // and the HAP Encrypted Notification advertisement type (0x11).
+    size_t i = 0;
+    while (i < numBytes) {
+        size_t length = bytes[i];
+        if (!length || length > numBytes - i - 1) {
+            return false;
+        }
+        if (length >= 4 && bytes[i + 1] == 0xFF && bytes[i + 2] == 0x4C && bytes[i + 3] == 0x00 &&
+            bytes[i + 4] == 0x11) {
+            return true;
+        }
+        i += 1 + length;
+    }
+    return false;
+}
+
 void HAPPlatformBLEPeripheralManagerStartAdvertising(
         HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
         HAPBLEAdvertisingInterval advertisingInterval,
@@ -333,20 +586,67 @@ void HAPPlatformBLEPeripheralManagerStartAdvertising(
     HAPPrecondition(advertisingInterval);
     HAPPrecondition(advertisingBytes);
     HAPPrecondition(numAdvertisingBytes);
-    HAPPrecondition(numAdvertisingBytes <= sizeof blePeripheralManager->advertisingBytes);
+    HAPPrecondition(numAdvertisingBytes <= sizeof blePeripheralManager->advertisements[0].advertisingBytes);
     HAPPrecondition(!numScanResponseBytes || scanResponseBytes);
-    HAPPrecondition(numScanResponseBytes <= sizeof blePeripheralManager->scanResponseBytes);
+    HAPPrecondition(numScanResponseBytes <= sizeof blePeripheralManager->advertisements[0].scanResponseBytes);
 
-    HAPPlatformBLEPeripheralManagerStopAdvertising(blePeripheralManager);
+    // The advertising payload is kept after advertising stops so that unchanged payloads are not rebuilt.
+    HAPAssert(blePeripheralManager->advertisementIndex < HAPArrayCount(blePeripheralManager->advertisements));
+    const HAPPlatformBLEPeripheralManagerAdvertisement* current =
+            &blePeripheralManager->advertisements[blePeripheralManager->advertisementIndex];
+    bool isPayloadChanged =
+            numAdvertisingBytes != current->numAdvertisingBytes ||
+            !HAPRawBufferAreEqual(current->advertisingBytes, advertisingBytes, numAdvertisingBytes) ||
+            numScanResponseBytes != current->numScanResponseBytes ||
+            (numScanResponseBytes &&
+             !HAPRawBufferAreEqual(current->scanResponseBytes, HAPNonnullVoid(scanResponseBytes), numScanResponseBytes));
+    bool wasAdvertising = HAPPlatformBLEPeripheralManagerIsAdvertising(blePeripheralManager);
+    if (wasAdvertising && !isPayloadChanged &&
+        advertisingInterval == blePeripheralManager->preferredAdvertisingInterval) {
+        return;
+    }
+
+    if (isPayloadChanged) {
+        // The new payload is built in the inactive slot and then swapped in. The BLE stack may keep referencing the
+        // active slot until it is handed the new one, so a change never tears the payload that is on air.
+        uint8_t advertisementIndex = (uint8_t)(blePeripheralManager->advertisementIndex ^ 1);
+        HAPPlatformBLEPeripheralManagerAdvertisement* next = &blePeripheralManager->advertisements[advertisementIndex];
+        HAPRawBufferCopyBytes(next->advertisingBytes, advertisingBytes, numAdvertisingBytes);
+        next->numAdvertisingBytes = (uint8_t) numAdvertisingBytes;
+        if (scanResponseBytes) {
+            HAPRawBufferCopyBytes(next->scanResponseBytes, HAPNonnullVoid(scanResponseBytes), numScanResponseBytes);
+        }
+        next->numScanResponseBytes = (uint8_t) numScanResponseBytes;
+        blePeripheralManager->advertisementIndex = advertisementIndex;
 
-    HAPRawBufferCopyBytes(blePeripheralManager->advertisingBytes, advertisingBytes, numAdvertisingBytes);
-    blePeripheralManager->numAdvertisingBytes = (uint8_t) numAdvertisingBytes;
-    if (scanResponseBytes) {
-        HAPRawBufferCopyBytes(
-                blePeripheralManager->scanResponseBytes, HAPNonnullVoid(scanResponseBytes), numScanResponseBytes);
+        if (IsBroadcastNotification(next->advertisingBytes, next->numAdvertisingBytes)) {
+            blePeripheralManager->numBroadcastNotifications++;
+            HAPLogDebug(
+                    &logObject,
+                    "Advertising broadcast notification (%lu so far).",
+                    (unsigned long) blePeripheralManager->numBroadcastNotifications);
+        }
+
+        // Changed advertising data indicates a state change. Burst so that controllers pick it up quickly.
+        StartFastAdvertising(blePeripheralManager);
     }
-    blePeripheralManager->numScanResponseBytes = (uint8_t) numScanResponseBytes;
-    blePeripheralManager->advertisingInterval = advertisingInterval;
+    if ((isPayloadChanged || !wasAdvertising) && blePeripheralManager->updateAdvertisingData) {
+        // The payload is also handed over when advertising restarts, since the BLE stack dropped it when it stopped.
+        const HAPPlatformBLEPeripheralManagerAdvertisement* advertisement =
+                &blePeripheralManager->advertisements[blePeripheralManager->advertisementIndex];
+        blePeripheralManager->updateAdvertisingData(
+                blePeripheralManager,
+                advertisement->advertisingBytes,
+                advertisement->numAdvertisingBytes,
+                advertisement->numScanResponseBytes ? advertisement->scanResponseBytes : NULL,
+                advertisement->numScanResponseBytes,
+                blePeripheralManager->context);
+    }
+    if (!wasAdvertising) {
+        blePeripheralManager->advertisingStartTime = HAPPlatformClockGetCurrent();
+    }
+    blePeripheralManager->preferredAdvertisingInterval = advertisingInterval;
+    UpdateAdvertisingInterval(blePeripheralManager);
 }
 
 void HAPPlatformBLEPeripheralManagerStopAdvertising(HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager) {
@@ -354,11 +654,16 @@ void HAPPlatformBLEPeripheralManagerStopAdvertising(HAPPlatformBLEPeripheralMana
     HAPPrecondition(blePeripheralManager->isDeviceAddressSet);
     HAPPrecondition(blePeripheralManager->didPublishAttributes);
 
-    HAPRawBufferZero(blePeripheralManager->advertisingBytes, sizeof blePeripheralManager->advertisingBytes);
-    blePeripheralManager->numAdvertisingBytes = 0;
-    HAPRawBufferZero(blePeripheralManager->scanResponseBytes, sizeof blePeripheralManager->scanResponseBytes);
-    blePeripheralManager->numScanResponseBytes = 0;
+    if (blePeripheralManager->fastAdvertisingTimer) {
+        HAPPlatformTimerDeregister(blePeripheralManager->fastAdvertisingTimer);
+        blePeripheralManager->fastAdvertisingTimer = 0;
+    }
+    bool wasAdvertising = HAPPlatformBLEPeripheralManagerIsAdvertising(blePeripheralManager);
     blePeripheralManager->advertisingInterval = 0;
+    blePeripheralManager->preferredAdvertisingInterval = 0;
+    if (wasAdvertising && blePeripheralManager->updateAdvertisingInterval) {
+        blePeripheralManager->updateAdvertisingInterval(blePeripheralManager, 0, blePeripheralManager->context);
+    }
 }
 
 HAP_RESULT_USE_CHECK
@@ -394,34 +699,356 @@ HAPError HAPPlatformBLEPeripheralManagerGetAdvertisingData(
     HAPPrecondition(scanResponseBytes);
     HAPPrecondition(numScanResponseBytes);
 
-    if (maxAdvertisingBytes < blePeripheralManager->numAdvertisingBytes) {
+    HAPAssert(blePeripheralManager->advertisementIndex < HAPArrayCount(blePeripheralManager->advertisements));
+    const HAPPlatformBLEPeripheralManagerAdvertisement* current =
+            &blePeripheralManager->advertisements[blePeripheralManager->advertisementIndex];
+    if (maxAdvertisingBytes < current->numAdvertisingBytes) {
         HAPLogError(
                 &logObject,
                 "Not enough space to store advertising data (%zu / %u bytes)",
                 maxAdvertisingBytes,
-                blePeripheralManager->numAdvertisingBytes);
+                current->numAdvertisingBytes);
         return kHAPError_OutOfResources;
     }
-    if (maxScanResponseBytes < blePeripheralManager->numScanResponseBytes) {
+    if (maxScanResponseBytes < current->numScanResponseBytes) {
         HAPLogError(
                 &logObject,
                 "Not enough space to store advertising data (%zu / %u bytes)",
                 maxScanResponseBytes,
-                blePeripheralManager->numScanResponseBytes);
+                current->numScanResponseBytes);
         return kHAPError_OutOfResources;
     }
 
-    HAPRawBufferCopyBytes(
-            advertisingBytes, blePeripheralManager->advertisingBytes, blePeripheralManager->numAdvertisingBytes);
-    *numAdvertisingBytes = blePeripheralManager->numAdvertisingBytes;
+    HAPRawBufferCopyBytes(advertisingBytes, current->advertisingBytes, current->numAdvertisingBytes);
+    *numAdvertisingBytes = current->numAdvertisingBytes;
 
-    HAPRawBufferCopyBytes(
-            scanResponseBytes, blePeripheralManager->scanResponseBytes, blePeripheralManager->numScanResponseBytes);
-    *numScanResponseBytes = blePeripheralManager->numScanResponseBytes;
+    HAPRawBufferCopyBytes(scanResponseBytes, current->scanResponseBytes, current->numScanResponseBytes);
+    *numScanResponseBytes = current->numScanResponseBytes;
 
     return kHAPError_None;
 }
 
+/**
+ * Adds the time since the current connection parameter regime started to the statistics.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ */
+static void AccumulateRegimeDuration(HAPPlatformBLEPeripheralManagerRef blePeripheralManager) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->isConnected);
+
+    HAPTime now = HAPPlatformClockGetCurrent();
+    HAPTime duration = now - blePeripheralManager->regimeStartTime;
+    if (blePeripheralManager->isIdle) {
+        blePeripheralManager->statistics.idleDuration += duration;
+    } else {
+        blePeripheralManager->statistics.activeDuration += duration;
+    }
+    blePeripheralManager->regimeStartTime = now;
+}
+
+/**
+ * Switches between the active and the idle connection parameters.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ * @param      isIdle               Whether the idle connection parameters should be requested.
+ */
+static void RequestConnectionParameters(HAPPlatformBLEPeripheralManagerRef blePeripheralManager, bool isIdle) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->isConnected);
+
+    AccumulateRegimeDuration(blePeripheralManager);
+    blePeripheralManager->isIdle = isIdle;
+
+    const HAPPlatformBLEPeripheralManagerConnectionParameters* parameters =
+            isIdle ? &blePeripheralManager->idleConnectionParameters :
+                     &blePeripheralManager->activeConnectionParameters;
+    HAPLogDebug(
+            &logObject,
+            "Requesting %s connection parameters: interval %u - %u, slave latency %u, supervision timeout %u.",
+            isIdle ? "idle" : "active",
+            parameters->minInterval,
+            parameters->maxInterval,
+            parameters->slaveLatency,
+            parameters->supervisionTimeout);
+    if (blePeripheralManager->updateConnectionParameters) {
+        blePeripheralManager->statistics.numConnectionParameterUpdates++;
+        blePeripheralManager->updateConnectionParameters(
+                blePeripheralManager,
+                blePeripheralManager->connectionHandle,
+                parameters,
+                blePeripheralManager->context);
+    }
+}
+
+static void QuietTimerExpired(HAPPlatformTimerRef timer, void* _Nullable context) {
+    HAPPrecondition(context);
+    HAPPlatformBLEPeripheralManagerRef blePeripheralManager = context;
+    HAPPrecondition(timer == blePeripheralManager->quietTimer);
+    blePeripheralManager->quietTimer = 0;
+
+    if (blePeripheralManager->isConnected && !blePeripheralManager->isIdle) {
+        RequestConnectionParameters(blePeripheralManager, /* isIdle: */ true);
+    }
+}
+
+/**
+ * Records GATT traffic on the current connection.
+ *
+ * - Short connection intervals are requested while there is traffic and relaxed after a quiet period.
+ *
+ * @param      blePeripheralManager BLE peripheral manager.
+ */
+static void HandleGATTActivity(HAPPlatformBLEPeripheralManagerRef blePeripheralManager) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->isConnected);
+
+    HAPError err;
+
+    if (blePeripheralManager->isIdle) {
+        RequestConnectionParameters(blePeripheralManager, /* isIdle: */ false);
+    }
+
+    if (blePeripheralManager->quietTimer) {
+        HAPPlatformTimerDeregister(blePeripheralManager->quietTimer);
+        blePeripheralManager->quietTimer = 0;
+    }
+    err = HAPPlatformTimerRegister(
+            &blePeripheralManager->quietTimer,
+            HAPPlatformClockGetCurrent() + blePeripheralManager->quietDuration,
+            QuietTimerExpired,
+            blePeripheralManager);
+    if (err) {
+        HAPAssert(err == kHAPError_OutOfResources);
+        HAPLog(&logObject, "Not enough resources to start quiet timer. Keeping active connection parameters.");
+        blePeripheralManager->quietTimer = 0;
+    }
+}
+
+void HAPPlatformBLEPeripheralManagerGetStatistics(
+        HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerStatistics* _Nonnull statistics) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(statistics);
+
+    if (blePeripheralManager->isConnected) {
+        AccumulateRegimeDuration(blePeripheralManager);
+    }
+    *statistics = blePeripheralManager->statistics;
+}
+
+void HAPPlatformBLEPeripheralManagerHandleCentralConnected(
+        HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(!blePeripheralManager->isConnected);
+
+    if (HAPPlatformBLEPeripheralManagerIsAdvertising(blePeripheralManager)) {
+        HAPLogInfo(
+                &logObject,
+                "Central connected %llu ms after advertising started.",
+                (unsigned long long) (HAPPlatformClockGetCurrent() - blePeripheralManager->advertisingStartTime));
+    }
+
+    blePeripheralManager->isConnected = true;
+    blePeripheralManager->connectionHandle = connectionHandle;
+    blePeripheralManager->attMTU = kHAPPlatformBLEPeripheralManager_DefaultATTMTU;
+    blePeripheralManager->dataLength = kHAPPlatformBLEPeripheralManager_DefaultDataLength;
+    blePeripheralManager->procedureAttributeHandle = 0;
+
+    // A pair verify follows right after connecting. Treat the connection as activity so that the active
+    // connection parameters are requested right away.
+    blePeripheralManager->regimeStartTime = HAPPlatformClockGetCurrent();
+    blePeripheralManager->isIdle = true;
+    HandleGATTActivity(blePeripheralManager);
+
+    if (blePeripheralManager->delegate.handleConnectedCentral) {
+        blePeripheralManager->delegate.handleConnectedCentral(
+                blePeripheralManager, connectionHandle, blePeripheralManager->delegate.context);
+    }
+}
+
+void HAPPlatformBLEPeripheralManagerHandleCentralDisconnected(
+        HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->isConnected);
+    HAPPrecondition(connectionHandle == blePeripheralManager->connectionHandle);
+
+    if (blePeripheralManager->quietTimer) {
+        HAPPlatformTimerDeregister(blePeripheralManager->quietTimer);
+        blePeripheralManager->quietTimer = 0;
+    }
+    AccumulateRegimeDuration(blePeripheralManager);
+    {
+        const HAPPlatformBLEPeripheralManagerStatistics* statistics = &blePeripheralManager->statistics;
+        HAPLogInfo(
+                &logObject,
+                "Connection statistics: active %llu ms, idle %llu ms, %lu parameter updates, "
+                "%lu procedures (avg %llu ms, max %llu ms).",
+                (unsigned long long) statistics->activeDuration,
+                (unsigned long long) statistics->idleDuration,
+                (unsigned long) statistics->numConnectionParameterUpdates,
+                (unsigned long) statistics->numProcedures,
+                (unsigned long long) (statistics->numProcedures ?
+                                              statistics->totalProcedureLatency / statistics->numProcedures :
+                                              0),
+                (unsigned long long) statistics->maxProcedureLatency);
+    }
+
+    blePeripheralManager->isConnected = false;
+    blePeripheralManager->connectionHandle = 0;
+    blePeripheralManager->attMTU = kHAPPlatformBLEPeripheralManager_DefaultATTMTU;
+    blePeripheralManager->dataLength = kHAPPlatformBLEPeripheralManager_DefaultDataLength;
+
+    // Controllers reconnect quickly after a disconnection. Burst so that the accessory is rediscovered fast.
+    StartFastAdvertising(blePeripheralManager);
+    if (HAPPlatformBLEPeripheralManagerIsAdvertising(blePeripheralManager)) {
+        blePeripheralManager->advertisingStartTime = HAPPlatformClockGetCurrent();
+        UpdateAdvertisingInterval(blePeripheralManager);
+    }
+
+    if (blePeripheralManager->delegate.handleDisconnectedCentral) {
+        blePeripheralManager->delegate.handleDisconnectedCentral(
+                blePeripheralManager, connectionHandle, blePeripheralManager->delegate.context);
+    }
+}
+
+HAP_RESULT_USE_CHECK
+uint16_t HAPPlatformBLEPeripheralManagerHandleMTUExchange(
+        HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle,
+        uint16_t clientRxMTU) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->isConnected);
+    HAPPrecondition(connectionHandle == blePeripheralManager->connectionHandle);
+
+    // See Bluetooth Core Specification Version 5.0, Vol 3, Part F, Section 3.4.2.2 Exchange MTU Response.
+    uint16_t attMTU = clientRxMTU < blePeripheralManager->maxATTMTU ? clientRxMTU : blePeripheralManager->maxATTMTU;
+    if (attMTU < kHAPPlatformBLEPeripheralManager_DefaultATTMTU) {
+        attMTU = kHAPPlatformBLEPeripheralManager_DefaultATTMTU;
+    }
+    blePeripheralManager->attMTU = attMTU;
+    HAPLogInfo(
+            &logObject,
+            "ATT MTU: %u (client Rx MTU: %u, server Rx MTU: %u).",
+            attMTU,
+            clientRxMTU,
+            blePeripheralManager->maxATTMTU);
+
+    return blePeripheralManager->maxATTMTU;
+}
+
+void HAPPlatformBLEPeripheralManagerHandleDataLengthChange(
+        HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle,
+        uint16_t maxTxOctets) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->isConnected);
+    HAPPrecondition(connectionHandle == blePeripheralManager->connectionHandle);
+
+    blePeripheralManager->dataLength = maxTxOctets;
+    HAPLogInfo(&logObject, "LE Data Length: %u bytes.", maxTxOctets);
+}
+
+HAP_RESULT_USE_CHECK
+uint16_t HAPPlatformBLEPeripheralManagerGetPreferredDataLength(
+        HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager) {
+    HAPPrecondition(blePeripheralManager);
+
+    // An ATT PDU of the full MTU plus 4 bytes of L2CAP header fits into a single link layer packet if possible.
+    uint32_t numPDUBytes = (uint32_t) blePeripheralManager->maxATTMTU + 4;
+    return numPDUBytes < blePeripheralManager->maxDataLength ? (uint16_t) numPDUBytes :
+                                                                blePeripheralManager->maxDataLength;
+}
+
+HAP_RESULT_USE_CHECK
+uint16_t HAPPlatformBLEPeripheralManagerGetATTMTU(HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager) {
+    HAPPrecondition(blePeripheralManager);
+
+    return blePeripheralManager->attMTU;
+}
+
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformBLEPeripheralManagerHandleReadRequest(
+        HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle,
+        HAPPlatformBLEPeripheralManagerAttributeHandle attributeHandle,
+        void* _Nonnull bytes,
+        size_t maxBytes,
+        size_t* _Nonnull numBytes) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->isConnected);
+    HAPPrecondition(connectionHandle == blePeripheralManager->connectionHandle);
+    HAPPrecondition(bytes);
+    HAPPrecondition(numBytes);
+
+    if (!blePeripheralManager->delegate.handleReadRequest) {
+        HAPLog(&logObject, "Rejecting read request: No delegate.");
+        return kHAPError_InvalidState;
+    }
+
+    HandleGATTActivity(blePeripheralManager);
+    if (blePeripheralManager->procedureAttributeHandle == attributeHandle) {
+        // HAP-BLE transactions consist of a write of the request followed by a read of the response.
+        HAPTime latency = HAPPlatformClockGetCurrent() - blePeripheralManager->procedureStartTime;
+        blePeripheralManager->procedureAttributeHandle = 0;
+        blePeripheralManager->statistics.numProcedures++;
+        blePeripheralManager->statistics.totalProcedureLatency += latency;
+        if (latency > blePeripheralManager->statistics.maxProcedureLatency) {
+            blePeripheralManager->statistics.maxProcedureLatency = latency;
+        }
+    }
+
+    // The HAP-BLE PDU layer sizes its fragments by the buffer it is given. Offering exactly the payload of a single
+    // ATT_READ_RSP (ATT MTU - 1 byte opcode) makes every fragment use the full negotiated MTU without Read Blob.
+    size_t maxResponseBytes = (size_t) blePeripheralManager->attMTU - 1;
+    if (maxBytes > maxResponseBytes) {
+        maxBytes = maxResponseBytes;
+    }
+
+    return blePeripheralManager->delegate.handleReadRequest(
+            blePeripheralManager,
+            connectionHandle,
+            attributeHandle,
+            bytes,
+            maxBytes,
+            numBytes,
+            blePeripheralManager->delegate.context);
+}
+
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformBLEPeripheralManagerHandleWriteRequest(
+        HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
+        HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle,
+        HAPPlatformBLEPeripheralManagerAttributeHandle attributeHandle,
+        void* _Nonnull bytes,
+        size_t numBytes) {
+    HAPPrecondition(blePeripheralManager);
+    HAPPrecondition(blePeripheralManager->isConnected);
+    HAPPrecondition(connectionHandle == blePeripheralManager->connectionHandle);
+    HAPPrecondition(bytes);
+
+    if (!blePeripheralManager->delegate.handleWriteRequest) {
+        HAPLog(&logObject, "Rejecting write request: No delegate.");
+        return kHAPError_InvalidState;
+    }
+
+    HandleGATTActivity(blePeripheralManager);
+    if (blePeripheralManager->procedureAttributeHandle != attributeHandle) {
+        blePeripheralManager->procedureAttributeHandle = attributeHandle;
+        blePeripheralManager->procedureStartTime = HAPPlatformClockGetCurrent();
+    }
+
+    return blePeripheralManager->delegate.handleWriteRequest(
+            blePeripheralManager,
+            connectionHandle,
+            attributeHandle,
+            bytes,
+            numBytes,
+            blePeripheralManager->delegate.context);
+}
+
 void HAPPlatformBLEPeripheralManagerCancelCentralConnection(
         HAPPlatformBLEPeripheralManagerRef _Nonnull blePeripheralManager,
         HAPPlatformBLEPeripheralManagerConnectionHandle connectionHandle) {
@@ -0,0 +1,215 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include <sys/time.h>
+
+#include <esp_attr.h>
+#include <esp_system.h>
+
+#include "HAPPlatform.h"
+#include "HAPPlatformBLESessionCache+Init.h"
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "BLESessionCache" };
+
+/**
+ * Marks a session cache in RTC memory that was written by this firmware.
+ */
+#define kHAPPlatformBLESessionCache_Magic ((uint32_t) 0x48415053)
+
+/**
+ * Interval at which the wall clock is recorded while the accessory runs.
+ */
+#define kHAPPlatformBLESessionCache_HeartbeatInterval ((HAPTime)(10 * HAPSecond))
+
+/**
+ * Session cache kept in RTC memory. Not initialized on boot.
+ */
+typedef struct {
+    /** kHAPPlatformBLESessionCache_Magic if the cache is valid. */
+    uint32_t magic;
+
+    /** Size of this structure. Guards against a different firmware layout after an update. */
+    uint32_t numBytes;
+
+    /** Wall clock in microseconds when the accessory was last seen running. */
+    int64_t savedAt;
+
+    /** Session cache elements used by the accessory server. */
+    HAPBLESessionCacheElementRef elements[kHAPBLESessionCache_MinElements];
+} HAPPlatformBLESessionCacheRetained;
+
+static RTC_NOINIT_ATTR HAPPlatformBLESessionCacheRetained retained;
+
+static struct {
+    /** Session cache elements kept from before the restart, until they are restored. */
+    HAPBLESessionCacheElementRef elements[kHAPBLESessionCache_MinElements];
+    size_t numElements;
+
+    HAPPlatformTimerRef heartbeatTimer;
+    bool isInitialized : 1;
+} sessionCache;
+
+/**
+ * Returns the wall clock in microseconds.
+ */
+HAP_RESULT_USE_CHECK
+static int64_t GetWallClock(void) {
+    struct timeval t;
+    int e = gettimeofday(&t, NULL);
+    if (e) {
+        int _errno = errno;
+        HAPAssert(e == -1);
+        HAPLogError(&logObject, "gettimeofday failed: %d.", _errno);
+        HAPFatalError();
+    }
+    return (int64_t) t.tv_sec * 1000000 + (int64_t) t.tv_usec;
+}
+
+/**
+ * Records that the accessory is running. Also called on the way into esp_restart.
+ */
+static void Stamp(void) {
+    retained.savedAt = GetWallClock();
+    retained.numBytes = sizeof retained;
+    retained.magic = kHAPPlatformBLESessionCache_Magic;
+}
+
+static void HeartbeatTimerExpired(HAPPlatformTimerRef timer, void* _Nullable context HAP_UNUSED) {
+    HAPAssert(timer == sessionCache.heartbeatTimer);
+    sessionCache.heartbeatTimer = 0;
+
+    Stamp();
+
+    HAPError err = HAPPlatformTimerRegister(
+            &sessionCache.heartbeatTimer,
+            HAPPlatformClockGetCurrent() + kHAPPlatformBLESessionCache_HeartbeatInterval,
+            HeartbeatTimerExpired,
+            NULL);
+    if (err) {
+        HAPAssert(err == kHAPError_OutOfResources);
+        HAPLogError(&logObject, "Not enough resources to schedule heartbeat. Session cache will not survive a crash.");
+        sessionCache.heartbeatTimer = 0;
+    }
+}
+
+/**
+ * Checks whether the chip was reset in a way that keeps RTC memory intact.
+ */
+HAP_RESULT_USE_CHECK
+static bool KeepsRTCMemory(esp_reset_reason_t reason) {
+    switch (reason) {
+        case ESP_RST_SW:
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+        case ESP_RST_DEEPSLEEP: {
+            return true;
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+size_t HAPPlatformBLESessionCacheCreate(void) {
+    HAPPrecondition(!sessionCache.isInitialized);
+
+    HAPRawBufferZero(&sessionCache, sizeof sessionCache);
+    sessionCache.isInitialized = true;
+
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (!KeepsRTCMemory(reason)) {
+        HAPLogInfo(&logObject, "Session cache not kept (reset reason %d).", (int) reason);
+    } else if (retained.magic != kHAPPlatformBLESessionCache_Magic || retained.numBytes != sizeof retained) {
+        HAPLogInfo(&logObject, "Session cache not kept (no valid cache in RTC memory).");
+    } else {
+        int64_t age = GetWallClock() - retained.savedAt;
+        if (age < 0 || age > (int64_t) CONFIG_HAP_BLE_SESSION_CACHE_PERSIST_TIMEOUT * 1000000) {
+            HAPLogInfo(&logObject, "Session cache not kept (expired).");
+        } else {
+            for (size_t i = 0; i < HAPArrayCount(retained.elements); i++) {
+                if (!HAPRawBufferIsZero(&retained.elements[i], sizeof retained.elements[i])) {
+                    sessionCache.numElements++;
+                }
+            }
+            HAPRawBufferCopyBytes(sessionCache.elements, retained.elements, sizeof sessionCache.elements);
+            HAPLogInfo(
+                    &logObject,
+                    "Session cache kept: %zu sessions, saved %lu ms ago.",
+                    sessionCache.numElements,
+                    (unsigned long) (age / 1000));
+        }
+    }
+    if (!sessionCache.numElements) {
+        HAPRawBufferZero(sessionCache.elements, sizeof sessionCache.elements);
+    }
+
+    // The accessory server takes over the RTC memory and resets it when created. It is invalid until restored, so a
+    // reset during startup does not keep a half-initialized cache.
+    HAPRawBufferZero(&retained, sizeof retained);
+
+    esp_err_t e = esp_register_shutdown_handler(Stamp);
+    if (e != ESP_OK) {
+        HAPLog(&logObject, "esp_register_shutdown_handler failed: %d.", e);
+    }
+
+    return sessionCache.numElements;
+}
+
+HAP_RESULT_USE_CHECK
+HAPBLESessionCacheElementRef* HAPPlatformBLESessionCacheGetElements(size_t* numElements) {
+    HAPPrecondition(sessionCache.isInitialized);
+    HAPPrecondition(numElements);
+
+    *numElements = HAPArrayCount(retained.elements);
+    return retained.elements;
+}
+
+void HAPPlatformBLESessionCacheRestore(void) {
+    HAPPrecondition(sessionCache.isInitialized);
+    HAPPrecondition(!sessionCache.heartbeatTimer);
+
+    HAPRawBufferCopyBytes(retained.elements, sessionCache.elements, sizeof retained.elements);
+    HAPRawBufferZero(sessionCache.elements, sizeof sessionCache.elements);
+    sessionCache.numElements = 0;
+
+    Stamp();
+    HAPError err = HAPPlatformTimerRegister(
+            &sessionCache.heartbeatTimer,
+            HAPPlatformClockGetCurrent() + kHAPPlatformBLESessionCache_HeartbeatInterval,
+            HeartbeatTimerExpired,
+            NULL);
+    if (err) {
+        HAPAssert(err == kHAPError_OutOfResources);
+        HAPLogError(&logObject, "Not enough resources to schedule heartbeat. Session cache will not survive a crash.");
+        sessionCache.heartbeatTimer = 0;
+    }
+}
+
+void HAPPlatformBLESessionCacheInvalidate(void) {
+    HAPPrecondition(sessionCache.isInitialized);
+
+    HAPLogInfo(&logObject, "Discarding session cache.");
+    HAPRawBufferZero(retained.elements, sizeof retained.elements);
+    HAPRawBufferZero(sessionCache.elements, sizeof sessionCache.elements);
+    sessionCache.numElements = 0;
+}
@@ -22,40 +22,59 @@
 #include <sys/time.h>
 #include <time.h>
 
+#if defined(ESP_PLATFORM)
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#endif
+
 #include "HAPPlatform.h"
+#include "HAPPlatformClock+Init.h"
 
 static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "Clock" };
 
-HAPTime HAPPlatformClockGetCurrent(void) {
-    int e;
+/**
+ * Latest time that was handed out. Guards monotonicity across threads.
+ */
+static uint64_t previousNow;
+
+#if defined(ESP_PLATFORM)
+/**
+ * Guards previousNow. 64-bit atomics are not native on Xtensa and would be served by libatomic.
+ */
+static portMUX_TYPE previousNowLock = portMUX_INITIALIZER_UNLOCKED;
+#endif
 
+HAP_RESULT_USE_CHECK
+uint64_t HAPPlatformClockGetCurrentMicroseconds(void) {
     static bool isInitialized;
-    static HAPTime previousNow;
 
     // Get current time.
-    HAPTime now;
-#if defined(CLOCK_MONOTONIC_RAW)
-    // This clock should be unaffected by frequency or time adjustments.
+    uint64_t now;
+#if defined(ESP_PLATFORM)
+    // The high resolution timer runs from boot and is read without a system call.
 
-    if (!isInitialized) {
-        HAPLog(&logObject, "Using 'clock_gettime' with 'CLOCK_MONOTONIC_RAW'.");
-        isInitialized = true;
+    if (!__atomic_exchange_n(&isInitialized, true, __ATOMIC_RELAXED)) {
+        HAPLog(&logObject, "Using 'esp_timer_get_time'.");
+    }
+
+    now = (uint64_t) esp_timer_get_time();
+#elif defined(CLOCK_MONOTONIC)
+    // This clock is unaffected by time adjustments. On Linux it is served from the vDSO without a system call,
+    // which CLOCK_MONOTONIC_RAW is not on all architectures.
+
+    if (!__atomic_exchange_n(&isInitialized, true, __ATOMIC_RELAXED)) {
+        HAPLog(&logObject, "Using 'clock_gettime' with 'CLOCK_MONOTONIC'.");
     }
 
     struct timespec t;
-    e = clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+    int e = clock_gettime(CLOCK_MONOTONIC, &t);
     if (e) {
         int _errno = errno;
         HAPAssert(e == -1);
         HAPLogError(&logObject, "clock_gettime failed: %d.", _errno);
         HAPFatalError();
     }
-    now = (HAPTime) t.tv_sec * 1000 + (HAPTime) t.tv_nsec / 1000000;
-
-    if (now < previousNow) {
-        HAPLog(&logObject, "Time jumped backwards by %lu ms.", (unsigned long) (previousNow - now));
-        HAPFatalError();
-    }
+    now = (uint64_t) t.tv_sec * 1000000 + (uint64_t) t.tv_nsec / 1000;
 #else
     // Portable fallback clock.
     // Note: `gettimeofday` is susceptible to significant jumps as it can be changed remotely (e.g. through NTP).
@@ -63,35 +82,63 @@ HAPTime HAPPlatformClockGetCurrent(void) {
     // When the time jumps forward timers may complete early and operations may fail.
     // This may happen for example when the system time is re-synchronized after joining a different network.
 
-    if (!isInitialized) {
+    if (!__atomic_exchange_n(&isInitialized, true, __ATOMIC_RELAXED)) {
         HAPLog(&logObject, "Using 'gettimeofday'.");
-        isInitialized = true;
     }
 
     struct timeval t;
-    e = gettimeofday(&t, NULL);
+    int e = gettimeofday(&t, NULL);
     if (e) {
         int _errno = errno;
         HAPAssert(e == -1);
         HAPLogError(&logObject, "gettimeofday failed: %d.", _errno);
         HAPFatalError();
     }
-    now = (HAPTime) t.tv_sec * 1000 + (HAPTime) t.tv_usec / 1000;
+    now = (uint64_t) t.tv_sec * 1000000 + (uint64_t) t.tv_usec;
 
-    static HAPTime offset;
-    if (now < previousNow) {
-        HAPLog(&logObject, "Time jumped backwards by %lu ms. Adjusting offset.", (unsigned long) (previousNow - now));
-        offset += previousNow - now;
+    static uint64_t offset;
+    now += __atomic_load_n(&offset, __ATOMIC_RELAXED);
+    uint64_t latest = __atomic_load_n(&previousNow, __ATOMIC_RELAXED);
+    if (now < latest && latest - now > 1000000) {
+        // Small differences come from concurrent readers and are clamped below.
+        HAPLog(&logObject,
+               "Time jumped backwards by %lu ms. Adjusting offset.",
+               (unsigned long) ((latest - now) / 1000));
+        __atomic_fetch_add(&offset, latest - now, __ATOMIC_RELAXED);
     }
-    now += offset;
 #endif
 
+    // Never hand out a time older than one that was handed out before. Another thread may have read the clock
+    // slightly later and published its time first, so times are clamped rather than treated as a jump.
+#if defined(ESP_PLATFORM)
+    portENTER_CRITICAL(&previousNowLock);
+    if (now <= previousNow) {
+        now = previousNow;
+    } else {
+        previousNow = now;
+    }
+    portEXIT_CRITICAL(&previousNowLock);
+#else
+    uint64_t previous = __atomic_load_n(&previousNow, __ATOMIC_RELAXED);
+    do {
+        if (now <= previous) {
+            return previous;
+        }
+    } while (!__atomic_compare_exchange_n(
+            &previousNow, &previous, now, /* weak: */ true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#endif
+
+    return now;
+}
+
+HAPTime HAPPlatformClockGetCurrent(void) {
+    HAPTime now = HAPPlatformClockGetCurrentMicroseconds() / 1000;
+
     // Check for overflow.
     if (now & (1ull << 63)) {
         HAPLog(&logObject, "Time overflowed (capped at 2^63 - 1).");
         HAPFatalError();
     }
 
-    previousNow = now;
     return now;
 }
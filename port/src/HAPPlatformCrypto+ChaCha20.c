@@ -0,0 +1,378 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "HAPPlatform.h"
+#include "HAPPlatformCrypto+Internal.h"
+
+// The portable kernel keeps the whole state in 32-bit registers, which suits the Xtensa LX6/LX7 cores of the ESP32
+// family. On hosts, several blocks are computed in parallel with SIMD, one block per vector lane.
+
+#define ROTL32(x, n) ((uint32_t)((x) << (n)) | (uint32_t)((x) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d) \
+    do { \
+        a += b; \
+        d ^= a; \
+        d = ROTL32(d, 16); \
+        c += d; \
+        b ^= c; \
+        b = ROTL32(b, 12); \
+        a += b; \
+        d ^= a; \
+        d = ROTL32(d, 8); \
+        c += d; \
+        b ^= c; \
+        b = ROTL32(b, 7); \
+    } while (0)
+
+/**
+ * Quarter round on vectors, given add, xor and rotate-left operations.
+ */
+#define VQUARTERROUND(ADD, XOR, ROTL, a, b, c, d) \
+    do { \
+        a = ADD(a, b); \
+        d = XOR(d, a); \
+        d = ROTL(d, 16); \
+        c = ADD(c, d); \
+        b = XOR(b, c); \
+        b = ROTL(b, 12); \
+        a = ADD(a, b); \
+        d = XOR(d, a); \
+        d = ROTL(d, 8); \
+        c = ADD(c, d); \
+        b = XOR(b, c); \
+        b = ROTL(b, 7); \
+    } while (0)
+
+#define VDOUBLEROUND(ADD, XOR, ROTL, x) \
+    do { \
+        VQUARTERROUND(ADD, XOR, ROTL, x[0], x[4], x[8], x[12]); \
+        VQUARTERROUND(ADD, XOR, ROTL, x[1], x[5], x[9], x[13]); \
+        VQUARTERROUND(ADD, XOR, ROTL, x[2], x[6], x[10], x[14]); \
+        VQUARTERROUND(ADD, XOR, ROTL, x[3], x[7], x[11], x[15]); \
+        VQUARTERROUND(ADD, XOR, ROTL, x[0], x[5], x[10], x[15]); \
+        VQUARTERROUND(ADD, XOR, ROTL, x[1], x[6], x[11], x[12]); \
+        VQUARTERROUND(ADD, XOR, ROTL, x[2], x[7], x[8], x[13]); \
+        VQUARTERROUND(ADD, XOR, ROTL, x[3], x[4], x[9], x[14]); \
+    } while (0)
+
+HAP_RESULT_USE_CHECK
+static uint32_t LoadUInt32LE(const uint8_t* bytes) {
+    return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+static void StoreUInt32LE(uint8_t* bytes, uint32_t value) {
+    bytes[0] = (uint8_t)(value & 0xFFU);
+    bytes[1] = (uint8_t)(value >> 8 & 0xFFU);
+    bytes[2] = (uint8_t)(value >> 16 & 0xFFU);
+    bytes[3] = (uint8_t)(value >> 24 & 0xFFU);
+}
+
+/**
+ * Generates key stream blocks one at a time.
+ *
+ * @param[out] bytes                Buffer to fill with key stream.
+ * @param      numBlocks            Number of blocks to generate.
+ * @param      input                Initial state. The block counter is advanced.
+ */
+static void ChaCha20BlocksScalar(uint8_t* bytes, size_t numBlocks, uint32_t* input) {
+    for (size_t block = 0; block < numBlocks; block++) {
+        uint32_t x0 = input[0], x1 = input[1], x2 = input[2], x3 = input[3];
+        uint32_t x4 = input[4], x5 = input[5], x6 = input[6], x7 = input[7];
+        uint32_t x8 = input[8], x9 = input[9], x10 = input[10], x11 = input[11];
+        uint32_t x12 = input[12], x13 = input[13], x14 = input[14], x15 = input[15];
+        for (int i = 0; i < 10; i++) {
+            QUARTERROUND(x0, x4, x8, x12);
+            QUARTERROUND(x1, x5, x9, x13);
+            QUARTERROUND(x2, x6, x10, x14);
+            QUARTERROUND(x3, x7, x11, x15);
+            QUARTERROUND(x0, x5, x10, x15);
+            QUARTERROUND(x1, x6, x11, x12);
+            QUARTERROUND(x2, x7, x8, x13);
+            QUARTERROUND(x3, x4, x9, x14);
+        }
+        uint8_t* out = &bytes[block * kHAPPlatformCryptoChaCha20_BlockBytes];
+        StoreUInt32LE(&out[0], x0 + input[0]);
+        StoreUInt32LE(&out[4], x1 + input[1]);
+        StoreUInt32LE(&out[8], x2 + input[2]);
+        StoreUInt32LE(&out[12], x3 + input[3]);
+        StoreUInt32LE(&out[16], x4 + input[4]);
+        StoreUInt32LE(&out[20], x5 + input[5]);
+        StoreUInt32LE(&out[24], x6 + input[6]);
+        StoreUInt32LE(&out[28], x7 + input[7]);
+        StoreUInt32LE(&out[32], x8 + input[8]);
+        StoreUInt32LE(&out[36], x9 + input[9]);
+        StoreUInt32LE(&out[40], x10 + input[10]);
+        StoreUInt32LE(&out[44], x11 + input[11]);
+        StoreUInt32LE(&out[48], x12 + input[12]);
+        StoreUInt32LE(&out[52], x13 + input[13]);
+        StoreUInt32LE(&out[56], x14 + input[14]);
+        StoreUInt32LE(&out[60], x15 + input[15]);
+        input[12]++;
+    }
+}
+
+#if defined(__AVX2__)
+
+#define HAVE_PARALLEL_BLOCKS 1
+#define kNumParallelBlocks   ((size_t) 8)
+
+#define ADD256(a, b) _mm256_add_epi32(a, b)
+#define XOR256(a, b) _mm256_xor_si256(a, b)
+#define ROTL256(x, n) \
+    ((n) == 16 ? _mm256_shuffle_epi8( \
+                         x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, \
+                                            13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2)) : \
+     (n) == 8 ? _mm256_shuffle_epi8( \
+                         x, _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3, \
+                                            14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3)) : \
+                _mm256_or_si256(_mm256_slli_epi32(x, (n)), _mm256_srli_epi32(x, 32 - (n))))
+
+/**
+ * Generates groups of 8 key stream blocks. Lane i of each vector belongs to block i.
+ */
+static void ChaCha20BlocksParallel(uint8_t* bytes, size_t numGroups, uint32_t* input) {
+    for (size_t group = 0; group < numGroups; group++) {
+        __m256i s[16], x[16];
+        for (size_t i = 0; i < 16; i++) {
+            s[i] = _mm256_set1_epi32((int) input[i]);
+        }
+        s[12] = _mm256_add_epi32(s[12], _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+        for (size_t i = 0; i < 16; i++) {
+            x[i] = s[i];
+        }
+        for (int i = 0; i < 10; i++) {
+            VDOUBLEROUND(ADD256, XOR256, ROTL256, x);
+        }
+        for (size_t i = 0; i < 16; i++) {
+            x[i] = _mm256_add_epi32(x[i], s[i]);
+        }
+        // Transpose 4x4 words within each 128-bit half. The low half holds blocks 0-3, the high half blocks 4-7.
+        uint8_t* out = &bytes[group * kNumParallelBlocks * kHAPPlatformCryptoChaCha20_BlockBytes];
+        for (size_t w = 0; w < 16; w += 4) {
+            __m256i a0 = _mm256_unpacklo_epi32(x[w + 0], x[w + 1]);
+            __m256i a1 = _mm256_unpacklo_epi32(x[w + 2], x[w + 3]);
+            __m256i a2 = _mm256_unpackhi_epi32(x[w + 0], x[w + 1]);
+            __m256i a3 = _mm256_unpackhi_epi32(x[w + 2], x[w + 3]);
+            __m256i r[4];
+            r[0] = _mm256_unpacklo_epi64(a0, a1);
+            r[1] = _mm256_unpackhi_epi64(a0, a1);
+            r[2] = _mm256_unpacklo_epi64(a2, a3);
+            r[3] = _mm256_unpackhi_epi64(a2, a3);
+            for (size_t b = 0; b < 4; b++) {
+                _mm_storeu_si128(
+                        (__m128i*) &out[b * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                        _mm256_castsi256_si128(r[b]));
+                _mm_storeu_si128(
+                        (__m128i*) &out[(b + 4) * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                        _mm256_extracti128_si256(r[b], 1));
+            }
+        }
+        input[12] += kNumParallelBlocks;
+    }
+}
+
+#elif defined(__SSE2__)
+
+#define HAVE_PARALLEL_BLOCKS 1
+#define kNumParallelBlocks   ((size_t) 4)
+
+#define ADD128(a, b) _mm_add_epi32(a, b)
+#define XOR128(a, b) _mm_xor_si128(a, b)
+#define ROTL128(x, n) _mm_or_si128(_mm_slli_epi32(x, (n)), _mm_srli_epi32(x, 32 - (n)))
+
+/**
+ * Generates groups of 4 key stream blocks. Lane i of each vector belongs to block i.
+ */
+static void ChaCha20BlocksParallel(uint8_t* bytes, size_t numGroups, uint32_t* input) {
+    for (size_t group = 0; group < numGroups; group++) {
+        __m128i s[16], x[16];
+        for (size_t i = 0; i < 16; i++) {
+            s[i] = _mm_set1_epi32((int) input[i]);
+        }
+        s[12] = _mm_add_epi32(s[12], _mm_set_epi32(3, 2, 1, 0));
+        for (size_t i = 0; i < 16; i++) {
+            x[i] = s[i];
+        }
+        for (int i = 0; i < 10; i++) {
+            VDOUBLEROUND(ADD128, XOR128, ROTL128, x);
+        }
+        for (size_t i = 0; i < 16; i++) {
+            x[i] = _mm_add_epi32(x[i], s[i]);
+        }
+        uint8_t* out = &bytes[group * kNumParallelBlocks * kHAPPlatformCryptoChaCha20_BlockBytes];
+        for (size_t w = 0; w < 16; w += 4) {
+            __m128i a0 = _mm_unpacklo_epi32(x[w + 0], x[w + 1]);
+            __m128i a1 = _mm_unpacklo_epi32(x[w + 2], x[w + 3]);
+            __m128i a2 = _mm_unpackhi_epi32(x[w + 0], x[w + 1]);
+            __m128i a3 = _mm_unpackhi_epi32(x[w + 2], x[w + 3]);
+            _mm_storeu_si128((__m128i*) &out[0 * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                             _mm_unpacklo_epi64(a0, a1));
+            _mm_storeu_si128((__m128i*) &out[1 * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                             _mm_unpackhi_epi64(a0, a1));
+            _mm_storeu_si128((__m128i*) &out[2 * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                             _mm_unpacklo_epi64(a2, a3));
+            _mm_storeu_si128((__m128i*) &out[3 * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                             _mm_unpackhi_epi64(a2, a3));
+        }
+        input[12] += kNumParallelBlocks;
+    }
+}
+
+#elif defined(__ARM_NEON) && defined(__ARM_ARCH_ISA_A64) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+#define HAVE_PARALLEL_BLOCKS 1
+#define kNumParallelBlocks   ((size_t) 4)
+
+#define ADDNEON(a, b) vaddq_u32(a, b)
+#define XORNEON(a, b) veorq_u32(a, b)
+#define ROTLNEON(x, n) \
+    ((n) == 16 ? vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(x))) : \
+                 vsriq_n_u32(vshlq_n_u32(x, (n)), x, 32 - (n)))
+
+/**
+ * Generates groups of 4 key stream blocks. Lane i of each vector belongs to block i.
+ */
+static void ChaCha20BlocksParallel(uint8_t* bytes, size_t numGroups, uint32_t* input) {
+    static const uint32_t laneOffsets[4] = { 0, 1, 2, 3 };
+    for (size_t group = 0; group < numGroups; group++) {
+        uint32x4_t s[16], x[16];
+        for (size_t i = 0; i < 16; i++) {
+            s[i] = vdupq_n_u32(input[i]);
+        }
+        s[12] = vaddq_u32(s[12], vld1q_u32(laneOffsets));
+        for (size_t i = 0; i < 16; i++) {
+            x[i] = s[i];
+        }
+        for (int i = 0; i < 10; i++) {
+            VDOUBLEROUND(ADDNEON, XORNEON, ROTLNEON, x);
+        }
+        for (size_t i = 0; i < 16; i++) {
+            x[i] = vaddq_u32(x[i], s[i]);
+        }
+        uint8_t* out = &bytes[group * kNumParallelBlocks * kHAPPlatformCryptoChaCha20_BlockBytes];
+        for (size_t w = 0; w < 16; w += 4) {
+            uint32x4x2_t p01 = vtrnq_u32(x[w + 0], x[w + 1]);
+            uint32x4x2_t p23 = vtrnq_u32(x[w + 2], x[w + 3]);
+            vst1q_u32((uint32_t*) (void*) &out[0 * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                      vcombine_u32(vget_low_u32(p01.val[0]), vget_low_u32(p23.val[0])));
+            vst1q_u32((uint32_t*) (void*) &out[1 * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                      vcombine_u32(vget_low_u32(p01.val[1]), vget_low_u32(p23.val[1])));
+            vst1q_u32((uint32_t*) (void*) &out[2 * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                      vcombine_u32(vget_high_u32(p01.val[0]), vget_high_u32(p23.val[0])));
+            vst1q_u32((uint32_t*) (void*) &out[3 * kHAPPlatformCryptoChaCha20_BlockBytes + w * 4],
+                      vcombine_u32(vget_high_u32(p01.val[1]), vget_high_u32(p23.val[1])));
+        }
+        input[12] += kNumParallelBlocks;
+    }
+}
+
+#endif
+
+void HAPPlatformCryptoChaCha20Blocks(
+        uint8_t* _Nonnull bytes,
+        size_t numBlocks,
+        const uint8_t* _Nonnull key,
+        const uint8_t* _Nonnull nonce,
+        uint32_t counter) {
+    HAPPrecondition(bytes);
+    HAPPrecondition(key);
+    HAPPrecondition(nonce);
+
+    uint32_t input[16];
+    input[0] = 0x61707865;
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+    for (size_t i = 0; i < 8; i++) {
+        input[4 + i] = LoadUInt32LE(&key[4 * i]);
+    }
+    input[12] = counter;
+    for (size_t i = 0; i < 3; i++) {
+        input[13 + i] = LoadUInt32LE(&nonce[4 * i]);
+    }
+
+#if HAVE_PARALLEL_BLOCKS
+    size_t numGroups = numBlocks / kNumParallelBlocks;
+    ChaCha20BlocksParallel(bytes, numGroups, input);
+    bytes += numGroups * kNumParallelBlocks * kHAPPlatformCryptoChaCha20_BlockBytes;
+    numBlocks -= numGroups * kNumParallelBlocks;
+#endif
+    ChaCha20BlocksScalar(bytes, numBlocks, input);
+    HAPRawBufferZero(input, sizeof input);
+}
+
+/**
+ * XORs a buffer with key stream.
+ *
+ * - Word-wise if all buffers are 32-bit aligned, as unaligned word access is not available on Xtensa.
+ */
+static void XorBytes(uint8_t* outBytes, const uint8_t* inBytes, const uint8_t* keyStream, size_t numBytes) {
+    size_t i = 0;
+    if ((((uintptr_t) outBytes | (uintptr_t) inBytes | (uintptr_t) keyStream) & 3) == 0) {
+        for (; i + 4 <= numBytes; i += 4) {
+            uint32_t a, b;
+            memcpy(&a, __builtin_assume_aligned(&inBytes[i], 4), 4);
+            memcpy(&b, __builtin_assume_aligned(&keyStream[i], 4), 4);
+            a ^= b;
+            memcpy(__builtin_assume_aligned(&outBytes[i], 4), &a, 4);
+        }
+    }
+    for (; i < numBytes; i++) {
+        outBytes[i] = inBytes[i] ^ keyStream[i];
+    }
+}
+
+void HAPPlatformCryptoChaCha20Xor(
+        uint8_t* _Nonnull outBytes,
+        const uint8_t* _Nonnull inBytes,
+        size_t numBytes,
+        const uint8_t* _Nonnull key,
+        const uint8_t* _Nonnull nonce,
+        uint32_t counter) {
+    HAPPrecondition(outBytes);
+    HAPPrecondition(inBytes);
+    HAPPrecondition(key);
+    HAPPrecondition(nonce);
+
+    // Multiple of the number of blocks processed in parallel by the SIMD kernels.
+    uint32_t keyStream[8 * kHAPPlatformCryptoChaCha20_BlockBytes / sizeof(uint32_t)];
+    while (numBytes) {
+        size_t numBlocks = HAPMin(
+                (numBytes + kHAPPlatformCryptoChaCha20_BlockBytes - 1) / kHAPPlatformCryptoChaCha20_BlockBytes,
+                sizeof keyStream / kHAPPlatformCryptoChaCha20_BlockBytes);
+        HAPPlatformCryptoChaCha20Blocks((uint8_t*) keyStream, numBlocks, key, nonce, counter);
+        size_t numChunkBytes = HAPMin(numBytes, numBlocks * kHAPPlatformCryptoChaCha20_BlockBytes);
+        XorBytes(outBytes, inBytes, (const uint8_t*) keyStream, numChunkBytes);
+        outBytes += numChunkBytes;
+        inBytes += numChunkBytes;
+        numBytes -= numChunkBytes;
+        counter += (uint32_t) numBlocks;
+    }
+    HAPRawBufferZero(keyStream, sizeof keyStream);
+}
@@ -0,0 +1,227 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "HAPPlatform.h"
+#include "HAPPlatformCrypto+Internal.h"
+
+// The ADK entry points are replaced at link time with -Wl,--wrap (see CMakeLists.txt). The original mbedTLS based
+// implementations remain reachable as __real_HAP_chacha20_poly1305_*.
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "Crypto" };
+
+/**
+ * Computes the Poly1305 tag over additional data and ciphertext.
+ */
+static void ComputeTag(
+        uint8_t* tag,
+        const uint8_t* _Nullable c,
+        size_t c_len,
+        const uint8_t* _Nullable a,
+        size_t a_len,
+        const uint8_t* n,
+        const uint8_t* k) {
+    uint8_t block[kHAPPlatformCryptoChaCha20_BlockBytes];
+    HAPPlatformCryptoChaCha20Blocks(block, 1, k, n, /* counter: */ 0);
+
+    HAPPlatformCryptoPoly1305Context context;
+    HAPPlatformCryptoPoly1305Init(&context, block);
+    HAPRawBufferZero(block, sizeof block);
+    if (a_len) {
+        HAPAssert(a);
+        HAPPlatformCryptoPoly1305Update(&context, HAPNonnull(a), a_len);
+        HAPPlatformCryptoPoly1305Pad(&context);
+    }
+    if (c_len) {
+        HAPAssert(c);
+        HAPPlatformCryptoPoly1305Update(&context, HAPNonnull(c), c_len);
+        HAPPlatformCryptoPoly1305Pad(&context);
+    }
+    uint8_t lengths[16];
+    HAPWriteLittleUInt64(&lengths[0], (uint64_t) a_len);
+    HAPWriteLittleUInt64(&lengths[8], (uint64_t) c_len);
+    HAPPlatformCryptoPoly1305Update(&context, lengths, sizeof lengths);
+    HAPPlatformCryptoPoly1305Final(&context, tag);
+}
+
+void HAPPlatformCryptoChaCha20Poly1305Encrypt(
+        uint8_t* _Nonnull tag,
+        uint8_t* _Nullable c,
+        const uint8_t* _Nullable m,
+        size_t m_len,
+        const uint8_t* _Nullable a,
+        size_t a_len,
+        const uint8_t* _Nonnull n,
+        const uint8_t* _Nonnull k) {
+    HAPPrecondition(tag);
+    HAPPrecondition(!m_len || (c && m));
+    HAPPrecondition(!a_len || a);
+    HAPPrecondition(n);
+    HAPPrecondition(k);
+
+    if (m_len) {
+        HAPPlatformCryptoChaCha20Xor(HAPNonnull(c), HAPNonnull(m), m_len, k, n, /* counter: */ 1);
+    }
+    ComputeTag(tag, c, m_len, a, a_len, n, k);
+}
+
+HAP_RESULT_USE_CHECK
+bool HAPPlatformCryptoChaCha20Poly1305Decrypt(
+        const uint8_t* _Nonnull tag,
+        uint8_t* _Nullable m,
+        const uint8_t* _Nullable c,
+        size_t c_len,
+        const uint8_t* _Nullable a,
+        size_t a_len,
+        const uint8_t* _Nonnull n,
+        const uint8_t* _Nonnull k) {
+    HAPPrecondition(tag);
+    HAPPrecondition(!c_len || (m && c));
+    HAPPrecondition(!a_len || a);
+    HAPPrecondition(n);
+    HAPPrecondition(k);
+
+    // Authenticate before decrypting, as decryption may happen in place.
+    uint8_t expectedTag[kHAPPlatformCryptoChaCha20Poly1305_TagBytes];
+    ComputeTag(expectedTag, c, c_len, a, a_len, n, k);
+    uint8_t difference = 0;
+    for (size_t i = 0; i < sizeof expectedTag; i++) {
+        difference |= (uint8_t)(expectedTag[i] ^ tag[i]);
+    }
+    HAPRawBufferZero(expectedTag, sizeof expectedTag);
+    if (difference) {
+        return false;
+    }
+
+    if (c_len) {
+        HAPPlatformCryptoChaCha20Xor(HAPNonnull(m), HAPNonnull(c), c_len, k, n, /* counter: */ 1);
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// ADK entry points.
+
+/**
+ * Expands a HAP nonce to the 96-bit IETF ChaCha20 nonce. Shorter nonces are left-padded with zeros.
+ */
+static void ExpandNonce(uint8_t* nonce, const uint8_t* n, size_t n_len) {
+    HAPPrecondition(n_len <= kHAPPlatformCryptoChaCha20_NonceBytes);
+
+    size_t numPaddingBytes = kHAPPlatformCryptoChaCha20_NonceBytes - n_len;
+    HAPRawBufferZero(nonce, numPaddingBytes);
+    HAPRawBufferCopyBytes(&nonce[numPaddingBytes], n, n_len);
+}
+
+/**
+ * Known answer test. Runs once before the first operation.
+ *
+ * @see RFC 7539, Section 2.8.2 Example and Test Vector for AEAD_CHACHA20_POLY1305
+ */
+static void EnsureKnownAnswerTestPassed(void) {
+    static volatile bool passed;
+    if (passed) {
+        return;
+    }
+
+    static const char plaintext[] =
+            "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen "
+            "would be it.";
+    static const uint8_t aad[] = { 0x50, 0x51, 0x52, 0x53, 0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7 };
+    static const uint8_t nonce[] = { 0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47 };
+    static const uint8_t expectedTag[] = { 0x1A, 0xE1, 0x0B, 0x59, 0x4F, 0x09, 0xE2, 0x6A,
+                                           0x7E, 0x90, 0x2E, 0xCB, 0xD0, 0x60, 0x06, 0x91 };
+    static const uint8_t expectedCiphertextPrefix[] = { 0xD3, 0x1A, 0x8D, 0x34, 0x64, 0x8E, 0x60, 0xDB,
+                                                        0x7B, 0x86, 0xAF, 0xBC, 0x53, 0xEF, 0x7E, 0xC2 };
+    uint8_t key[32];
+    for (size_t i = 0; i < sizeof key; i++) {
+        key[i] = (uint8_t)(0x80 + i);
+    }
+
+    uint8_t ciphertext[sizeof plaintext - 1];
+    uint8_t tag[kHAPPlatformCryptoChaCha20Poly1305_TagBytes];
+    HAPPlatformCryptoChaCha20Poly1305Encrypt(
+            tag, ciphertext, (const uint8_t*) plaintext, sizeof ciphertext, aad, sizeof aad, nonce, key);
+    uint8_t decrypted[sizeof ciphertext];
+    bool valid = HAPPlatformCryptoChaCha20Poly1305Decrypt(
+            tag, decrypted, ciphertext, sizeof ciphertext, aad, sizeof aad, nonce, key);
+    if (!HAPRawBufferAreEqual(tag, expectedTag, sizeof tag) ||
+        !HAPRawBufferAreEqual(ciphertext, expectedCiphertextPrefix, sizeof expectedCiphertextPrefix) || !valid ||
+        !HAPRawBufferAreEqual(decrypted, plaintext, sizeof decrypted)) {
+        HAPLogError(&logObject, "ChaCha20-Poly1305 known answer test failed.");
+        HAPFatalError();
+    }
+    passed = true;
+}
+
+void __wrap_HAP_chacha20_poly1305_encrypt_aad(
+        uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* c,
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]) {
+    EnsureKnownAnswerTestPassed();
+
+    uint8_t nonce[kHAPPlatformCryptoChaCha20_NonceBytes];
+    ExpandNonce(nonce, n, n_len);
+    HAPPlatformCryptoChaCha20Poly1305Encrypt(tag, c, m, m_len, a, a_len, nonce, k);
+}
+
+int __wrap_HAP_chacha20_poly1305_decrypt_aad(
+        const uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* m,
+        const uint8_t* c,
+        size_t c_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]) {
+    EnsureKnownAnswerTestPassed();
+
+    uint8_t nonce[kHAPPlatformCryptoChaCha20_NonceBytes];
+    ExpandNonce(nonce, n, n_len);
+    return HAPPlatformCryptoChaCha20Poly1305Decrypt(tag, m, c, c_len, a, a_len, nonce, k) ? 0 : -1;
+}
+
+void __wrap_HAP_chacha20_poly1305_encrypt(
+        uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* c,
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]) {
+    __wrap_HAP_chacha20_poly1305_encrypt_aad(tag, c, m, m_len, NULL, 0, n, n_len, k);
+}
+
+int __wrap_HAP_chacha20_poly1305_decrypt(
+        const uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* m,
+        const uint8_t* c,
+        size_t c_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]) {
+    return __wrap_HAP_chacha20_poly1305_decrypt_aad(tag, m, c, c_len, NULL, 0, n, n_len, k);
+}
@@ -0,0 +1,471 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HAP_PLATFORM_CRYPTO_INTERNAL_H
+#define HAP_PLATFORM_CRYPTO_INTERNAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <mbedtls/sha512.h>
+
+#include "HAPPlatform.h"
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull begin
+#endif
+
+/**
+ * ChaCha20 key length.
+ */
+#define kHAPPlatformCryptoChaCha20_KeyBytes ((size_t) 32)
+
+/**
+ * ChaCha20 nonce length (IETF variant).
+ */
+#define kHAPPlatformCryptoChaCha20_NonceBytes ((size_t) 12)
+
+/**
+ * ChaCha20 block length.
+ */
+#define kHAPPlatformCryptoChaCha20_BlockBytes ((size_t) 64)
+
+/**
+ * Generates ChaCha20 key stream blocks.
+ *
+ * @see RFC 7539, Section 2.3 The ChaCha20 Block Function
+ *
+ * @param[out] bytes                Buffer to fill with key stream.
+ * @param      numBlocks            Number of 64-byte blocks to generate.
+ * @param      key                  Key (32 bytes).
+ * @param      nonce                Nonce (12 bytes).
+ * @param      counter              Block counter of the first block.
+ */
+void HAPPlatformCryptoChaCha20Blocks(
+        uint8_t* bytes,
+        size_t numBlocks,
+        const uint8_t* key,
+        const uint8_t* nonce,
+        uint32_t counter);
+
+/**
+ * Encrypts or decrypts with ChaCha20 by XORing with the key stream.
+ *
+ * @param[out] outBytes             Output buffer. May be the same as the input buffer.
+ * @param      inBytes              Input buffer.
+ * @param      numBytes             Length of input.
+ * @param      key                  Key (32 bytes).
+ * @param      nonce                Nonce (12 bytes).
+ * @param      counter              Block counter of the first block.
+ */
+void HAPPlatformCryptoChaCha20Xor(
+        uint8_t* outBytes,
+        const uint8_t* inBytes,
+        size_t numBytes,
+        const uint8_t* key,
+        const uint8_t* nonce,
+        uint32_t counter);
+
+/**
+ * Poly1305 key length.
+ */
+#define kHAPPlatformCryptoPoly1305_KeyBytes ((size_t) 32)
+
+/**
+ * Poly1305 tag length.
+ */
+#define kHAPPlatformCryptoPoly1305_TagBytes ((size_t) 16)
+
+/**
+ * Poly1305 state.
+ *
+ * - Radix 2^44 with 64x64->128 bit multiplications where available, radix 2^26 with 32x32->64 bit multiplications
+ *   otherwise (e.g. on Xtensa).
+ */
+typedef struct {
+    /**@cond */
+#if defined(__SIZEOF_INT128__)
+    uint64_t r[3];
+    uint64_t h[3];
+#else
+    uint32_t r[5];
+    uint32_t h[5];
+#endif
+    uint32_t pad[4];
+    uint8_t buffer[16];
+    size_t numBufferBytes;
+    /**@endcond */
+} HAPPlatformCryptoPoly1305Context;
+
+/**
+ * Initializes a Poly1305 computation.
+ *
+ * @see RFC 7539, Section 2.5 The Poly1305 Algorithm
+ *
+ * @param[out] context              Poly1305 state.
+ * @param      key                  One-time key (32 bytes).
+ */
+void HAPPlatformCryptoPoly1305Init(HAPPlatformCryptoPoly1305Context* context, const uint8_t* key);
+
+/**
+ * Authenticates additional data.
+ *
+ * @param      context              Poly1305 state.
+ * @param      bytes                Data.
+ * @param      numBytes             Length of data.
+ */
+void HAPPlatformCryptoPoly1305Update(HAPPlatformCryptoPoly1305Context* context, const void* bytes, size_t numBytes);
+
+/**
+ * Pads the authenticated data with zeros to a multiple of 16 bytes.
+ *
+ * @param      context              Poly1305 state.
+ */
+void HAPPlatformCryptoPoly1305Pad(HAPPlatformCryptoPoly1305Context* context);
+
+/**
+ * Completes a Poly1305 computation.
+ *
+ * @param      context              Poly1305 state. Cleared on return.
+ * @param[out] tag                  Tag (16 bytes).
+ */
+void HAPPlatformCryptoPoly1305Final(HAPPlatformCryptoPoly1305Context* context, uint8_t* tag);
+
+/**
+ * ChaCha20-Poly1305 tag length.
+ */
+#define kHAPPlatformCryptoChaCha20Poly1305_TagBytes ((size_t) 16)
+
+/**
+ * Encrypts and authenticates a message with ChaCha20-Poly1305.
+ *
+ * @see RFC 7539, Section 2.8 AEAD Construction
+ *
+ * @param[out] tag                  Tag (16 bytes).
+ * @param[out] c                    Ciphertext. May be the same as the message buffer.
+ * @param      m                    Message.
+ * @param      m_len                Length of message.
+ * @param      a                    Additional authenticated data.
+ * @param      a_len                Length of additional authenticated data.
+ * @param      n                    Nonce (12 bytes).
+ * @param      k                    Key (32 bytes).
+ */
+void HAPPlatformCryptoChaCha20Poly1305Encrypt(
+        uint8_t* tag,
+        uint8_t* _Nullable c,
+        const uint8_t* _Nullable m,
+        size_t m_len,
+        const uint8_t* _Nullable a,
+        size_t a_len,
+        const uint8_t* n,
+        const uint8_t* k);
+
+/**
+ * Verifies and decrypts a message with ChaCha20-Poly1305.
+ *
+ * - The message is only written if the tag is valid.
+ *
+ * @param      tag                  Tag (16 bytes).
+ * @param[out] m                    Message. May be the same as the ciphertext buffer.
+ * @param      c                    Ciphertext.
+ * @param      c_len                Length of ciphertext.
+ * @param      a                    Additional authenticated data.
+ * @param      a_len                Length of additional authenticated data.
+ * @param      n                    Nonce (12 bytes).
+ * @param      k                    Key (32 bytes).
+ *
+ * @return true                     If the tag is valid.
+ * @return false                    Otherwise.
+ */
+HAP_RESULT_USE_CHECK
+bool HAPPlatformCryptoChaCha20Poly1305Decrypt(
+        const uint8_t* tag,
+        uint8_t* _Nullable m,
+        const uint8_t* _Nullable c,
+        size_t c_len,
+        const uint8_t* _Nullable a,
+        size_t a_len,
+        const uint8_t* n,
+        const uint8_t* k);
+
+/**
+ * SHA-512 block length.
+ */
+#define kHAPPlatformCryptoSHA512_BlockBytes ((size_t) 128)
+
+/**
+ * Computes SHA-512 over up to three concatenated parts.
+ *
+ * @param[out] md                   Digest (64 bytes).
+ * @param      a                    First part.
+ * @param      a_len                Length of first part.
+ * @param      b                    Second part.
+ * @param      b_len                Length of second part.
+ * @param      c                    Third part.
+ * @param      c_len                Length of third part.
+ */
+void HAPPlatformCryptoSHA512(
+        uint8_t* md,
+        const void* _Nullable a,
+        size_t a_len,
+        const void* _Nullable b,
+        size_t b_len,
+        const void* _Nullable c,
+        size_t c_len);
+
+/**
+ * HMAC-SHA-512 key, stored as the inner and outer padded key blocks.
+ *
+ * - Hash states are not kept across calls. With CONFIG_MBEDTLS_HARDWARE_SHA a live context holds the SHA accelerator
+ *   until it is freed, and clones of it continue in software.
+ */
+typedef struct {
+    /**@cond */
+    uint8_t innerPad[kHAPPlatformCryptoSHA512_BlockBytes];
+    uint8_t outerPad[kHAPPlatformCryptoSHA512_BlockBytes];
+    /**@endcond */
+} HAPPlatformCryptoHMACSHA512Key;
+
+/**
+ * Prepares an HMAC-SHA-512 key.
+ *
+ * - The key must be released with HAPPlatformCryptoHMACSHA512KeyRelease.
+ *
+ * @see RFC 2104, Section 2 Definition of HMAC
+ *
+ * @param[out] key                  Prepared key.
+ * @param      bytes                Key.
+ * @param      numBytes             Length of key.
+ */
+void HAPPlatformCryptoHMACSHA512KeyCreate(HAPPlatformCryptoHMACSHA512Key* key, const void* _Nullable bytes, size_t numBytes);
+
+/**
+ * Releases an HMAC-SHA-512 key.
+ *
+ * @param      key                  Prepared key.
+ */
+void HAPPlatformCryptoHMACSHA512KeyRelease(HAPPlatformCryptoHMACSHA512Key* key);
+
+/**
+ * Computes HMAC-SHA-512 over up to three concatenated parts.
+ *
+ * @param[out] mac                  MAC (64 bytes). May overlap the parts.
+ * @param      key                  Prepared key.
+ * @param      a                    First part.
+ * @param      a_len                Length of first part.
+ * @param      b                    Second part.
+ * @param      b_len                Length of second part.
+ * @param      c                    Third part.
+ * @param      c_len                Length of third part.
+ */
+void HAPPlatformCryptoHMACSHA512(
+        uint8_t* mac,
+        const HAPPlatformCryptoHMACSHA512Key* key,
+        const void* _Nullable a,
+        size_t a_len,
+        const void* _Nullable b,
+        size_t b_len,
+        const void* _Nullable c,
+        size_t c_len);
+
+/**
+ * ChaCha20-Poly1305 entry points of the ADK crypto API, replaced at link time with -Wl,--wrap.
+ *
+ * - __wrap_ functions are the optimized implementations. __real_ functions are the original mbedTLS based ones.
+ */
+/**@{*/
+void __wrap_HAP_chacha20_poly1305_encrypt_aad(
+        uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* c,
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+void __real_HAP_chacha20_poly1305_encrypt_aad(
+        uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* c,
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+int __wrap_HAP_chacha20_poly1305_decrypt_aad(
+        const uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* m,
+        const uint8_t* c,
+        size_t c_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+int __real_HAP_chacha20_poly1305_decrypt_aad(
+        const uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* m,
+        const uint8_t* c,
+        size_t c_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+void __wrap_HAP_chacha20_poly1305_encrypt(
+        uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* c,
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+int __wrap_HAP_chacha20_poly1305_decrypt(
+        const uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* m,
+        const uint8_t* c,
+        size_t c_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+/**@}*/
+
+/**
+ * SRP entry points of the ADK crypto API, replaced at link time with -Wl,--wrap.
+ *
+ * - __wrap_ functions reuse the group parameters and Montgomery constants across calls.
+ *   __real_ functions are the original mbedTLS based ones.
+ */
+/**@{*/
+void __wrap_HAP_srp_public_key(
+        uint8_t pub_b[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]);
+void __real_HAP_srp_public_key(
+        uint8_t pub_b[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]);
+int __wrap_HAP_srp_premaster_secret(
+        uint8_t s[SRP_PREMASTER_SECRET_BYTES],
+        const uint8_t pub_a[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t u[SRP_SCRAMBLING_PARAMETER_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]);
+int __real_HAP_srp_premaster_secret(
+        uint8_t s[SRP_PREMASTER_SECRET_BYTES],
+        const uint8_t pub_a[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t u[SRP_SCRAMBLING_PARAMETER_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]);
+/**@}*/
+
+/**
+ * X25519 and Ed25519 entry points of the ADK crypto API, replaced at link time with -Wl,--wrap.
+ *
+ * - __wrap_ functions are the radix 2^25.5 implementations. __real_ functions are the original mbedTLS based ones.
+ */
+/**@{*/
+void __wrap_HAP_X25519_scalarmult_base(uint8_t r[X25519_BYTES], const uint8_t n[X25519_SCALAR_BYTES]);
+void __real_HAP_X25519_scalarmult_base(uint8_t r[X25519_BYTES], const uint8_t n[X25519_SCALAR_BYTES]);
+void __wrap_HAP_X25519_scalarmult(
+        uint8_t r[X25519_BYTES],
+        const uint8_t n[X25519_SCALAR_BYTES],
+        const uint8_t p[X25519_BYTES]);
+void __real_HAP_X25519_scalarmult(
+        uint8_t r[X25519_BYTES],
+        const uint8_t n[X25519_SCALAR_BYTES],
+        const uint8_t p[X25519_BYTES]);
+void __wrap_HAP_ed25519_public_key(uint8_t pk[ED25519_PUBLIC_KEY_BYTES], const uint8_t sk[ED25519_SECRET_KEY_BYTES]);
+void __real_HAP_ed25519_public_key(uint8_t pk[ED25519_PUBLIC_KEY_BYTES], const uint8_t sk[ED25519_SECRET_KEY_BYTES]);
+void __wrap_HAP_ed25519_sign(
+        uint8_t sig[ED25519_BYTES],
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t sk[ED25519_SECRET_KEY_BYTES],
+        const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+void __real_HAP_ed25519_sign(
+        uint8_t sig[ED25519_BYTES],
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t sk[ED25519_SECRET_KEY_BYTES],
+        const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+int __wrap_HAP_ed25519_verify(
+        const uint8_t sig[ED25519_BYTES],
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+int __real_HAP_ed25519_verify(
+        const uint8_t sig[ED25519_BYTES],
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+/**@}*/
+
+/**
+ * HMAC-SHA-512 and HKDF-SHA-512 entry points of the ADK crypto API, replaced at link time with -Wl,--wrap.
+ *
+ * - __wrap_ functions hash with the SHA accelerator when CONFIG_MBEDTLS_HARDWARE_SHA is enabled. __real_ functions
+ *   are the original mbedTLS based ones.
+ */
+/**@{*/
+void __wrap_HAP_hmac_sha512(
+        uint8_t r[HMAC_SHA512_BYTES],
+        const uint8_t* key,
+        size_t key_len,
+        const uint8_t* in,
+        size_t in_len);
+void __real_HAP_hmac_sha512(
+        uint8_t r[HMAC_SHA512_BYTES],
+        const uint8_t* key,
+        size_t key_len,
+        const uint8_t* in,
+        size_t in_len);
+void __wrap_HAP_hkdf_sha512(
+        uint8_t* r,
+        size_t r_len,
+        const uint8_t* key,
+        size_t key_len,
+        const uint8_t* salt,
+        size_t salt_len,
+        const uint8_t* info,
+        size_t info_len);
+void __real_HAP_hkdf_sha512(
+        uint8_t* r,
+        size_t r_len,
+        const uint8_t* key,
+        size_t key_len,
+        const uint8_t* salt,
+        size_t salt_len,
+        const uint8_t* info,
+        size_t info_len);
+/**@}*/
+
+#if __has_feature(nullability)
+#pragma clang assume_nonnull end
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,371 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "HAPPlatform.h"
+#include "HAPPlatformCrypto+Internal.h"
+
+// Based on the public domain poly1305-donna implementation by Andrew Moon.
+
+HAP_RESULT_USE_CHECK
+static uint32_t LoadUInt32LE(const uint8_t* bytes) {
+    return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+static void StoreUInt32LE(uint8_t* bytes, uint32_t value) {
+    bytes[0] = (uint8_t)(value & 0xFFU);
+    bytes[1] = (uint8_t)(value >> 8 & 0xFFU);
+    bytes[2] = (uint8_t)(value >> 16 & 0xFFU);
+    bytes[3] = (uint8_t)(value >> 24 & 0xFFU);
+}
+
+#if defined(__SIZEOF_INT128__)
+
+typedef unsigned __int128 uint128_t;
+
+HAP_RESULT_USE_CHECK
+static uint64_t LoadUInt64LE(const uint8_t* bytes) {
+    return (uint64_t) LoadUInt32LE(&bytes[0]) | (uint64_t) LoadUInt32LE(&bytes[4]) << 32;
+}
+
+static void StoreUInt64LE(uint8_t* bytes, uint64_t value) {
+    StoreUInt32LE(&bytes[0], (uint32_t) value);
+    StoreUInt32LE(&bytes[4], (uint32_t)(value >> 32));
+}
+
+#define kMask44 ((uint64_t) 0xFFFFFFFFFFF)
+#define kMask42 ((uint64_t) 0x3FFFFFFFFFF)
+
+static void InitializeKey(HAPPlatformCryptoPoly1305Context* context, const uint8_t* key) {
+    uint64_t t0 = LoadUInt64LE(&key[0]);
+    uint64_t t1 = LoadUInt64LE(&key[8]);
+    context->r[0] = t0 & 0xFFC0FFFFFFF;
+    context->r[1] = (t0 >> 44 | t1 << 20) & 0xFFFFFC0FFFF;
+    context->r[2] = t1 >> 24 & 0x00FFFFFFC0F;
+    context->h[0] = 0;
+    context->h[1] = 0;
+    context->h[2] = 0;
+}
+
+/**
+ * Processes full 16-byte blocks.
+ *
+ * @param      context              Poly1305 state.
+ * @param      bytes                Blocks.
+ * @param      numBlocks            Number of blocks.
+ * @param      isFinal              Whether this is the padded last block, which does not get the high bit set.
+ */
+static void ProcessBlocks(HAPPlatformCryptoPoly1305Context* context, const uint8_t* bytes, size_t numBlocks, bool isFinal) {
+    uint64_t hibit = isFinal ? 0 : (uint64_t) 1 << 40;
+    uint64_t r0 = context->r[0], r1 = context->r[1], r2 = context->r[2];
+    uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    uint64_t h0 = context->h[0], h1 = context->h[1], h2 = context->h[2];
+
+    for (size_t i = 0; i < numBlocks; i++, bytes += 16) {
+        uint64_t t0 = LoadUInt64LE(&bytes[0]);
+        uint64_t t1 = LoadUInt64LE(&bytes[8]);
+        h0 += t0 & kMask44;
+        h1 += (t0 >> 44 | t1 << 20) & kMask44;
+        h2 += (t1 >> 24 & kMask42) | hibit;
+
+        uint128_t d0 = (uint128_t) h0 * r0 + (uint128_t) h1 * s2 + (uint128_t) h2 * s1;
+        uint128_t d1 = (uint128_t) h0 * r1 + (uint128_t) h1 * r0 + (uint128_t) h2 * s2;
+        uint128_t d2 = (uint128_t) h0 * r2 + (uint128_t) h1 * r1 + (uint128_t) h2 * r0;
+
+        uint64_t c = (uint64_t)(d0 >> 44);
+        h0 = (uint64_t) d0 & kMask44;
+        d1 += c;
+        c = (uint64_t)(d1 >> 44);
+        h1 = (uint64_t) d1 & kMask44;
+        d2 += c;
+        c = (uint64_t)(d2 >> 42);
+        h2 = (uint64_t) d2 & kMask42;
+        h0 += c * 5;
+        c = h0 >> 44;
+        h0 &= kMask44;
+        h1 += c;
+    }
+
+    context->h[0] = h0;
+    context->h[1] = h1;
+    context->h[2] = h2;
+}
+
+static void Finish(HAPPlatformCryptoPoly1305Context* context, uint8_t* tag) {
+    uint64_t h0 = context->h[0], h1 = context->h[1], h2 = context->h[2];
+
+    // Fully carry h.
+    uint64_t c = h1 >> 44;
+    h1 &= kMask44;
+    h2 += c;
+    c = h2 >> 42;
+    h2 &= kMask42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= kMask44;
+    h1 += c;
+    c = h1 >> 44;
+    h1 &= kMask44;
+    h2 += c;
+    c = h2 >> 42;
+    h2 &= kMask42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= kMask44;
+    h1 += c;
+
+    // Compute h - p and select it if h >= p, in constant time.
+    uint64_t g0 = h0 + 5;
+    c = g0 >> 44;
+    g0 &= kMask44;
+    uint64_t g1 = h1 + c;
+    c = g1 >> 44;
+    g1 &= kMask44;
+    uint64_t g2 = h2 + c - ((uint64_t) 1 << 42);
+    c = (g2 >> 63) - 1;
+    g0 &= c;
+    g1 &= c;
+    g2 &= c;
+    c = ~c;
+    h0 = (h0 & c) | g0;
+    h1 = (h1 & c) | g1;
+    h2 = (h2 & c) | g2;
+
+    // Add pad.
+    uint64_t t0 = (uint64_t) context->pad[0] | (uint64_t) context->pad[1] << 32;
+    uint64_t t1 = (uint64_t) context->pad[2] | (uint64_t) context->pad[3] << 32;
+    h0 += t0 & kMask44;
+    c = h0 >> 44;
+    h0 &= kMask44;
+    h1 += ((t0 >> 44 | t1 << 20) & kMask44) + c;
+    c = h1 >> 44;
+    h1 &= kMask44;
+    h2 += (t1 >> 24 & kMask42) + c;
+    h2 &= kMask42;
+
+    StoreUInt64LE(&tag[0], h0 | h1 << 44);
+    StoreUInt64LE(&tag[8], h1 >> 20 | h2 << 24);
+}
+
+#else
+
+#define kMask26 ((uint32_t) 0x3FFFFFF)
+
+static void InitializeKey(HAPPlatformCryptoPoly1305Context* context, const uint8_t* key) {
+    context->r[0] = LoadUInt32LE(&key[0]) & 0x3FFFFFF;
+    context->r[1] = LoadUInt32LE(&key[3]) >> 2 & 0x3FFFF03;
+    context->r[2] = LoadUInt32LE(&key[6]) >> 4 & 0x3FFC0FF;
+    context->r[3] = LoadUInt32LE(&key[9]) >> 6 & 0x3F03FFF;
+    context->r[4] = LoadUInt32LE(&key[12]) >> 8 & 0x00FFFFF;
+    for (size_t i = 0; i < 5; i++) {
+        context->h[i] = 0;
+    }
+}
+
+/**
+ * Processes full 16-byte blocks.
+ *
+ * @param      context              Poly1305 state.
+ * @param      bytes                Blocks.
+ * @param      numBlocks            Number of blocks.
+ * @param      isFinal              Whether this is the padded last block, which does not get the high bit set.
+ */
+static void ProcessBlocks(HAPPlatformCryptoPoly1305Context* context, const uint8_t* bytes, size_t numBlocks, bool isFinal) {
+    uint32_t hibit = isFinal ? 0 : (uint32_t) 1 << 24;
+    uint32_t r0 = context->r[0], r1 = context->r[1], r2 = context->r[2], r3 = context->r[3], r4 = context->r[4];
+    uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = context->h[0], h1 = context->h[1], h2 = context->h[2], h3 = context->h[3], h4 = context->h[4];
+
+    for (size_t i = 0; i < numBlocks; i++, bytes += 16) {
+        h0 += LoadUInt32LE(&bytes[0]) & kMask26;
+        h1 += LoadUInt32LE(&bytes[3]) >> 2 & kMask26;
+        h2 += LoadUInt32LE(&bytes[6]) >> 4 & kMask26;
+        h3 += LoadUInt32LE(&bytes[9]) >> 6 & kMask26;
+        h4 += LoadUInt32LE(&bytes[12]) >> 8 | hibit;
+
+        uint64_t d0 = (uint64_t) h0 * r0 + (uint64_t) h1 * s4 + (uint64_t) h2 * s3 + (uint64_t) h3 * s2 +
+                      (uint64_t) h4 * s1;
+        uint64_t d1 = (uint64_t) h0 * r1 + (uint64_t) h1 * r0 + (uint64_t) h2 * s4 + (uint64_t) h3 * s3 +
+                      (uint64_t) h4 * s2;
+        uint64_t d2 = (uint64_t) h0 * r2 + (uint64_t) h1 * r1 + (uint64_t) h2 * r0 + (uint64_t) h3 * s4 +
+                      (uint64_t) h4 * s3;
+        uint64_t d3 = (uint64_t) h0 * r3 + (uint64_t) h1 * r2 + (uint64_t) h2 * r1 + (uint64_t) h3 * r0 +
+                      (uint64_t) h4 * s4;
+        uint64_t d4 = (uint64_t) h0 * r4 + (uint64_t) h1 * r3 + (uint64_t) h2 * r2 + (uint64_t) h3 * r1 +
+                      (uint64_t) h4 * r0;
+
+        uint32_t c = (uint32_t)(d0 >> 26);
+        h0 = (uint32_t) d0 & kMask26;
+        d1 += c;
+        c = (uint32_t)(d1 >> 26);
+        h1 = (uint32_t) d1 & kMask26;
+        d2 += c;
+        c = (uint32_t)(d2 >> 26);
+        h2 = (uint32_t) d2 & kMask26;
+        d3 += c;
+        c = (uint32_t)(d3 >> 26);
+        h3 = (uint32_t) d3 & kMask26;
+        d4 += c;
+        c = (uint32_t)(d4 >> 26);
+        h4 = (uint32_t) d4 & kMask26;
+        h0 += c * 5;
+        c = h0 >> 26;
+        h0 &= kMask26;
+        h1 += c;
+    }
+
+    context->h[0] = h0;
+    context->h[1] = h1;
+    context->h[2] = h2;
+    context->h[3] = h3;
+    context->h[4] = h4;
+}
+
+static void Finish(HAPPlatformCryptoPoly1305Context* context, uint8_t* tag) {
+    uint32_t h0 = context->h[0], h1 = context->h[1], h2 = context->h[2], h3 = context->h[3], h4 = context->h[4];
+
+    // Fully carry h.
+    uint32_t c = h1 >> 26;
+    h1 &= kMask26;
+    h2 += c;
+    c = h2 >> 26;
+    h2 &= kMask26;
+    h3 += c;
+    c = h3 >> 26;
+    h3 &= kMask26;
+    h4 += c;
+    c = h4 >> 26;
+    h4 &= kMask26;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= kMask26;
+    h1 += c;
+
+    // Compute h - p and select it if h >= p, in constant time.
+    uint32_t g0 = h0 + 5;
+    c = g0 >> 26;
+    g0 &= kMask26;
+    uint32_t g1 = h1 + c;
+    c = g1 >> 26;
+    g1 &= kMask26;
+    uint32_t g2 = h2 + c;
+    c = g2 >> 26;
+    g2 &= kMask26;
+    uint32_t g3 = h3 + c;
+    c = g3 >> 26;
+    g3 &= kMask26;
+    uint32_t g4 = h4 + c - ((uint32_t) 1 << 26);
+    uint32_t mask = (g4 >> 31) - 1;
+    g0 &= mask;
+    g1 &= mask;
+    g2 &= mask;
+    g3 &= mask;
+    g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    // h mod 2^128.
+    h0 = h0 | h1 << 26;
+    h1 = h1 >> 6 | h2 << 20;
+    h2 = h2 >> 12 | h3 << 14;
+    h3 = h3 >> 18 | h4 << 8;
+
+    // Add pad.
+    uint64_t f = (uint64_t) h0 + context->pad[0];
+    StoreUInt32LE(&tag[0], (uint32_t) f);
+    f = (uint64_t) h1 + context->pad[1] + (f >> 32);
+    StoreUInt32LE(&tag[4], (uint32_t) f);
+    f = (uint64_t) h2 + context->pad[2] + (f >> 32);
+    StoreUInt32LE(&tag[8], (uint32_t) f);
+    f = (uint64_t) h3 + context->pad[3] + (f >> 32);
+    StoreUInt32LE(&tag[12], (uint32_t) f);
+}
+
+#endif
+
+void HAPPlatformCryptoPoly1305Init(HAPPlatformCryptoPoly1305Context* _Nonnull context, const uint8_t* _Nonnull key) {
+    HAPPrecondition(context);
+    HAPPrecondition(key);
+
+    InitializeKey(context, key);
+    for (size_t i = 0; i < 4; i++) {
+        context->pad[i] = LoadUInt32LE(&key[16 + 4 * i]);
+    }
+    context->numBufferBytes = 0;
+}
+
+void HAPPlatformCryptoPoly1305Update(
+        HAPPlatformCryptoPoly1305Context* _Nonnull context,
+        const void* _Nonnull bytes_,
+        size_t numBytes) {
+    HAPPrecondition(context);
+    HAPPrecondition(bytes_);
+    const uint8_t* bytes = bytes_;
+
+    if (context->numBufferBytes) {
+        size_t n = HAPMin(numBytes, sizeof context->buffer - context->numBufferBytes);
+        HAPRawBufferCopyBytes(&context->buffer[context->numBufferBytes], bytes, n);
+        context->numBufferBytes += n;
+        bytes += n;
+        numBytes -= n;
+        if (context->numBufferBytes < sizeof context->buffer) {
+            return;
+        }
+        ProcessBlocks(context, context->buffer, 1, /* isFinal: */ false);
+        context->numBufferBytes = 0;
+    }
+    size_t numBlocks = numBytes / 16;
+    if (numBlocks) {
+        ProcessBlocks(context, bytes, numBlocks, /* isFinal: */ false);
+        bytes += numBlocks * 16;
+        numBytes -= numBlocks * 16;
+    }
+    if (numBytes) {
+        HAPRawBufferCopyBytes(context->buffer, bytes, numBytes);
+        context->numBufferBytes = numBytes;
+    }
+}
+
+void HAPPlatformCryptoPoly1305Pad(HAPPlatformCryptoPoly1305Context* _Nonnull context) {
+    HAPPrecondition(context);
+
+    if (context->numBufferBytes) {
+        HAPRawBufferZero(&context->buffer[context->numBufferBytes], sizeof context->buffer - context->numBufferBytes);
+        ProcessBlocks(context, context->buffer, 1, /* isFinal: */ false);
+        context->numBufferBytes = 0;
+    }
+}
+
+void HAPPlatformCryptoPoly1305Final(HAPPlatformCryptoPoly1305Context* _Nonnull context, uint8_t* _Nonnull tag) {
+    HAPPrecondition(context);
+    HAPPrecondition(tag);
+
+    if (context->numBufferBytes) {
+        context->buffer[context->numBufferBytes] = 1;
+        HAPRawBufferZero(
+                &context->buffer[context->numBufferBytes + 1], sizeof context->buffer - context->numBufferBytes - 1);
+        ProcessBlocks(context, context->buffer, 1, /* isFinal: */ true);
+    }
+    Finish(context, tag);
+    HAPRawBufferZero(context, sizeof *context);
+}
@@ -0,0 +1,244 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <mbedtls/sha512.h>
+
+#include "HAPPlatform.h"
+#include "HAPPlatformCrypto+Internal.h"
+
+// SHA-512 goes through mbedTLS, which uses the SHA accelerator when CONFIG_MBEDTLS_HARDWARE_SHA is enabled and falls
+// back to software while the accelerator is busy. A context claims the accelerator when it processes its first block
+// and holds it until it is freed, and a clone of such a context continues in software. Every hash is therefore done
+// with a fresh context that is freed right away, and HMAC keys keep the padded key blocks instead of hash states.
+//
+// The ADK entry points are replaced at link time with -Wl,--wrap (see CMakeLists.txt). The original implementations
+// remain reachable as __real_HAP_hmac_sha512 and __real_HAP_hkdf_sha512.
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "Crypto" };
+
+/**
+ * Aborts on mbedTLS errors. These can only be caused by accelerator failures.
+ */
+#define SHA_CHECK(f) \
+    do { \
+        int e = (f); \
+        if (e) { \
+            HAPLogError(&logObject, "%s failed: %d.", #f, e); \
+            HAPFatalError(); \
+        } \
+    } while (0)
+
+/**
+ * Absorbs up to three parts into a SHA-512 computation.
+ */
+static void Update(
+        mbedtls_sha512_context* context,
+        const void* _Nullable a,
+        size_t a_len,
+        const void* _Nullable b,
+        size_t b_len,
+        const void* _Nullable c,
+        size_t c_len) {
+    if (a_len) {
+        SHA_CHECK(mbedtls_sha512_update_ret(context, HAPNonnullVoid(a), a_len));
+    }
+    if (b_len) {
+        SHA_CHECK(mbedtls_sha512_update_ret(context, HAPNonnullVoid(b), b_len));
+    }
+    if (c_len) {
+        SHA_CHECK(mbedtls_sha512_update_ret(context, HAPNonnullVoid(c), c_len));
+    }
+}
+
+void HAPPlatformCryptoSHA512(
+        uint8_t* md,
+        const void* _Nullable a,
+        size_t a_len,
+        const void* _Nullable b,
+        size_t b_len,
+        const void* _Nullable c,
+        size_t c_len) {
+    HAPPrecondition(md);
+
+    mbedtls_sha512_context context;
+    mbedtls_sha512_init(&context);
+    SHA_CHECK(mbedtls_sha512_starts_ret(&context, /* is384: */ 0));
+    Update(&context, a, a_len, b, b_len, c, c_len);
+    SHA_CHECK(mbedtls_sha512_finish_ret(&context, md));
+    mbedtls_sha512_free(&context);
+}
+
+void HAPPlatformCryptoHMACSHA512KeyCreate(HAPPlatformCryptoHMACSHA512Key* key, const void* _Nullable bytes, size_t numBytes) {
+    HAPPrecondition(key);
+    HAPPrecondition(bytes || !numBytes);
+
+    // See RFC 2104, Section 2 Definition of HMAC.
+    HAPRawBufferZero(key->innerPad, sizeof key->innerPad);
+    if (numBytes > sizeof key->innerPad) {
+        HAPPlatformCryptoSHA512(key->innerPad, bytes, numBytes, NULL, 0, NULL, 0);
+    } else if (numBytes) {
+        HAPRawBufferCopyBytes(key->innerPad, HAPNonnullVoid(bytes), numBytes);
+    }
+    for (size_t i = 0; i < sizeof key->innerPad; i++) {
+        key->outerPad[i] = key->innerPad[i] ^ 0x5C;
+        key->innerPad[i] ^= 0x36;
+    }
+}
+
+void HAPPlatformCryptoHMACSHA512KeyRelease(HAPPlatformCryptoHMACSHA512Key* key) {
+    HAPPrecondition(key);
+
+    HAPRawBufferZero(key, sizeof *key);
+}
+
+void HAPPlatformCryptoHMACSHA512(
+        uint8_t* mac,
+        const HAPPlatformCryptoHMACSHA512Key* key,
+        const void* _Nullable a,
+        size_t a_len,
+        const void* _Nullable b,
+        size_t b_len,
+        const void* _Nullable c,
+        size_t c_len) {
+    HAPPrecondition(mac);
+    HAPPrecondition(key);
+
+    // The inner context is freed before the outer one starts, so that both can claim the accelerator.
+    mbedtls_sha512_context context;
+    mbedtls_sha512_init(&context);
+    SHA_CHECK(mbedtls_sha512_starts_ret(&context, /* is384: */ 0));
+    SHA_CHECK(mbedtls_sha512_update_ret(&context, key->innerPad, sizeof key->innerPad));
+    Update(&context, a, a_len, b, b_len, c, c_len);
+    SHA_CHECK(mbedtls_sha512_finish_ret(&context, mac));
+    mbedtls_sha512_free(&context);
+
+    mbedtls_sha512_init(&context);
+    SHA_CHECK(mbedtls_sha512_starts_ret(&context, /* is384: */ 0));
+    SHA_CHECK(mbedtls_sha512_update_ret(&context, key->outerPad, sizeof key->outerPad));
+    SHA_CHECK(mbedtls_sha512_update_ret(&context, mac, SHA512_BYTES));
+    SHA_CHECK(mbedtls_sha512_finish_ret(&context, mac));
+    mbedtls_sha512_free(&context);
+}
+
+/**
+ * Checks HMAC-SHA-512 against RFC 4231 test cases 2 and 6 (short key and key longer than one block).
+ */
+static void EnsureKnownAnswerTestPassed(void) {
+    static bool passed;
+    if (passed) {
+        return;
+    }
+
+    static const uint8_t expectedMAC2[SHA512_BYTES] = {
+        0x16, 0x4B, 0x7A, 0x7B, 0xFC, 0xF8, 0x19, 0xE2, 0xE3, 0x95, 0xFB, 0xE7,
+        0x3B, 0x56, 0xE0, 0xA3, 0x87, 0xBD, 0x64, 0x22, 0x2E, 0x83, 0x1F, 0xD6,
+        0x10, 0x27, 0x0C, 0xD7, 0xEA, 0x25, 0x05, 0x54, 0x97, 0x58, 0xBF, 0x75,
+        0xC0, 0x5A, 0x99, 0x4A, 0x6D, 0x03, 0x4F, 0x65, 0xF8, 0xF0, 0xE6, 0xFD,
+        0xCA, 0xEA, 0xB1, 0xA3, 0x4D, 0x4A, 0x6B, 0x4B, 0x63, 0x6E, 0x07, 0x0A,
+        0x38, 0xBC, 0xE7, 0x37,
+    };
+    static const uint8_t expectedMAC6[SHA512_BYTES] = {
+        0x80, 0xB2, 0x42, 0x63, 0xC7, 0xC1, 0xA3, 0xEB, 0xB7, 0x14, 0x93, 0xC1,
+        0xDD, 0x7B, 0xE8, 0xB4, 0x9B, 0x46, 0xD1, 0xF4, 0x1B, 0x4A, 0xEE, 0xC1,
+        0x12, 0x1B, 0x01, 0x37, 0x83, 0xF8, 0xF3, 0x52, 0x6B, 0x56, 0xD0, 0x37,
+        0xE0, 0x5F, 0x25, 0x98, 0xBD, 0x0F, 0xD2, 0x21, 0x5D, 0x6A, 0x1E, 0x52,
+        0x95, 0xE6, 0x4F, 0x73, 0xF6, 0x3F, 0x0A, 0xEC, 0x8B, 0x91, 0x5A, 0x98,
+        0x5D, 0x78, 0x65, 0x98,
+    };
+    static const char message6[] = "Test Using Larger Than Block-Size Key - Hash Key First";
+    uint8_t key6[131];
+    for (size_t i = 0; i < sizeof key6; i++) {
+        key6[i] = 0xAA;
+    }
+
+    uint8_t mac[2][SHA512_BYTES];
+    HAPPlatformCryptoHMACSHA512Key key;
+    HAPPlatformCryptoHMACSHA512KeyCreate(&key, "Jefe", 4);
+    HAPPlatformCryptoHMACSHA512(mac[0], &key, "what do ya want ", 16, "for nothing?", 12, NULL, 0);
+    HAPPlatformCryptoHMACSHA512KeyRelease(&key);
+    HAPPlatformCryptoHMACSHA512KeyCreate(&key, key6, sizeof key6);
+    HAPPlatformCryptoHMACSHA512(mac[1], &key, message6, sizeof message6 - 1, NULL, 0, NULL, 0);
+    HAPPlatformCryptoHMACSHA512KeyRelease(&key);
+    if (!HAPRawBufferAreEqual(mac[0], expectedMAC2, sizeof mac[0]) ||
+        !HAPRawBufferAreEqual(mac[1], expectedMAC6, sizeof mac[1])) {
+        HAPLogError(&logObject, "HMAC-SHA-512 known answer test failed.");
+        HAPFatalError();
+    }
+    passed = true;
+}
+
+void __wrap_HAP_hmac_sha512(
+        uint8_t r[HMAC_SHA512_BYTES],
+        const uint8_t* key,
+        size_t key_len,
+        const uint8_t* in,
+        size_t in_len) {
+    HAPPrecondition(r);
+    HAPPrecondition(key || !key_len);
+    HAPPrecondition(in || !in_len);
+
+    EnsureKnownAnswerTestPassed();
+
+    HAPPlatformCryptoHMACSHA512Key hmacKey;
+    HAPPlatformCryptoHMACSHA512KeyCreate(&hmacKey, key, key_len);
+    HAPPlatformCryptoHMACSHA512(r, &hmacKey, in, in_len, NULL, 0, NULL, 0);
+    HAPPlatformCryptoHMACSHA512KeyRelease(&hmacKey);
+}
+
+void __wrap_HAP_hkdf_sha512(
+        uint8_t* r,
+        size_t r_len,
+        const uint8_t* key,
+        size_t key_len,
+        const uint8_t* salt,
+        size_t salt_len,
+        const uint8_t* info,
+        size_t info_len) {
+    HAPPrecondition(r);
+    HAPPrecondition(r_len <= 255 * SHA512_BYTES);
+    HAPPrecondition(key || !key_len);
+    HAPPrecondition(salt || !salt_len);
+    HAPPrecondition(info || !info_len);
+
+    EnsureKnownAnswerTestPassed();
+
+    // See RFC 5869, Section 2.2 Step 1: Extract.
+    uint8_t prk[SHA512_BYTES];
+    HAPPlatformCryptoHMACSHA512Key hmacKey;
+    HAPPlatformCryptoHMACSHA512KeyCreate(&hmacKey, salt, salt_len);
+    HAPPlatformCryptoHMACSHA512(prk, &hmacKey, key, key_len, NULL, 0, NULL, 0);
+    HAPPlatformCryptoHMACSHA512KeyRelease(&hmacKey);
+
+    // See RFC 5869, Section 2.3 Step 2: Expand. The padded PRK blocks are shared by all output blocks.
+    HAPPlatformCryptoHMACSHA512KeyCreate(&hmacKey, prk, sizeof prk);
+    uint8_t t[SHA512_BYTES];
+    size_t t_len = 0;
+    for (uint8_t counter = 1; r_len; counter++) {
+        HAPPlatformCryptoHMACSHA512(t, &hmacKey, t, t_len, info, info_len, &counter, sizeof counter);
+        t_len = sizeof t;
+        size_t numBytes = HAPMin(r_len, sizeof t);
+        HAPRawBufferCopyBytes(r, t, numBytes);
+        r += numBytes;
+        r_len -= numBytes;
+    }
+    HAPPlatformCryptoHMACSHA512KeyRelease(&hmacKey);
+    HAPRawBufferZero(prk, sizeof prk);
+    HAPRawBufferZero(t, sizeof t);
+}
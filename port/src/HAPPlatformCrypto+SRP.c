@@ -0,0 +1,247 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <mbedtls/bignum.h>
+
+#include "HAPPlatform.h"
+#include "HAPPlatformCrypto+Internal.h"
+
+// The ADK entry points are replaced at link time with -Wl,--wrap (see CMakeLists.txt). The original implementations
+// remain reachable as __real_HAP_srp_*.
+//
+// mbedtls_mpi_exp_mod runs on the RSA accelerator when CONFIG_MBEDTLS_HARDWARE_MPI is enabled and in software
+// otherwise. Either way it accepts a cached Montgomery constant R^2 mod N, which is only computed once here because
+// the SRP group is fixed. k * v mod N is cached for the most recently used verifier.
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "Crypto" };
+
+/**
+ * SRP group N (3072-bit).
+ *
+ * @see RFC 5054, Appendix A Group Parameters
+ */
+static const uint8_t srpN[SRP_PRIME_BYTES] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xC9, 0x0F, 0xDA, 0xA2,
+        0x21, 0x68, 0xC2, 0x34, 0xC4, 0xC6, 0x62, 0x8B, 0x80, 0xDC, 0x1C, 0xD1,
+        0x29, 0x02, 0x4E, 0x08, 0x8A, 0x67, 0xCC, 0x74, 0x02, 0x0B, 0xBE, 0xA6,
+        0x3B, 0x13, 0x9B, 0x22, 0x51, 0x4A, 0x08, 0x79, 0x8E, 0x34, 0x04, 0xDD,
+        0xEF, 0x95, 0x19, 0xB3, 0xCD, 0x3A, 0x43, 0x1B, 0x30, 0x2B, 0x0A, 0x6D,
+        0xF2, 0x5F, 0x14, 0x37, 0x4F, 0xE1, 0x35, 0x6D, 0x6D, 0x51, 0xC2, 0x45,
+        0xE4, 0x85, 0xB5, 0x76, 0x62, 0x5E, 0x7E, 0xC6, 0xF4, 0x4C, 0x42, 0xE9,
+        0xA6, 0x37, 0xED, 0x6B, 0x0B, 0xFF, 0x5C, 0xB6, 0xF4, 0x06, 0xB7, 0xED,
+        0xEE, 0x38, 0x6B, 0xFB, 0x5A, 0x89, 0x9F, 0xA5, 0xAE, 0x9F, 0x24, 0x11,
+        0x7C, 0x4B, 0x1F, 0xE6, 0x49, 0x28, 0x66, 0x51, 0xEC, 0xE4, 0x5B, 0x3D,
+        0xC2, 0x00, 0x7C, 0xB8, 0xA1, 0x63, 0xBF, 0x05, 0x98, 0xDA, 0x48, 0x36,
+        0x1C, 0x55, 0xD3, 0x9A, 0x69, 0x16, 0x3F, 0xA8, 0xFD, 0x24, 0xCF, 0x5F,
+        0x83, 0x65, 0x5D, 0x23, 0xDC, 0xA3, 0xAD, 0x96, 0x1C, 0x62, 0xF3, 0x56,
+        0x20, 0x85, 0x52, 0xBB, 0x9E, 0xD5, 0x29, 0x07, 0x70, 0x96, 0x96, 0x6D,
+        0x67, 0x0C, 0x35, 0x4E, 0x4A, 0xBC, 0x98, 0x04, 0xF1, 0x74, 0x6C, 0x08,
+        0xCA, 0x18, 0x21, 0x7C, 0x32, 0x90, 0x5E, 0x46, 0x2E, 0x36, 0xCE, 0x3B,
+        0xE3, 0x9E, 0x77, 0x2C, 0x18, 0x0E, 0x86, 0x03, 0x9B, 0x27, 0x83, 0xA2,
+        0xEC, 0x07, 0xA2, 0x8F, 0xB5, 0xC5, 0x5D, 0xF0, 0x6F, 0x4C, 0x52, 0xC9,
+        0xDE, 0x2B, 0xCB, 0xF6, 0x95, 0x58, 0x17, 0x18, 0x39, 0x95, 0x49, 0x7C,
+        0xEA, 0x95, 0x6A, 0xE5, 0x15, 0xD2, 0x26, 0x18, 0x98, 0xFA, 0x05, 0x10,
+        0x15, 0x72, 0x8E, 0x5A, 0x8A, 0xAA, 0xC4, 0x2D, 0xAD, 0x33, 0x17, 0x0D,
+        0x04, 0x50, 0x7A, 0x33, 0xA8, 0x55, 0x21, 0xAB, 0xDF, 0x1C, 0xBA, 0x64,
+        0xEC, 0xFB, 0x85, 0x04, 0x58, 0xDB, 0xEF, 0x0A, 0x8A, 0xEA, 0x71, 0x57,
+        0x5D, 0x06, 0x0C, 0x7D, 0xB3, 0x97, 0x0F, 0x85, 0xA6, 0xE1, 0xE4, 0xC7,
+        0xAB, 0xF5, 0xAE, 0x8C, 0xDB, 0x09, 0x33, 0xD7, 0x1E, 0x8C, 0x94, 0xE0,
+        0x4A, 0x25, 0x61, 0x9D, 0xCE, 0xE3, 0xD2, 0x26, 0x1A, 0xD2, 0xEE, 0x6B,
+        0xF1, 0x2F, 0xFA, 0x06, 0xD9, 0x8A, 0x08, 0x64, 0xD8, 0x76, 0x02, 0x73,
+        0x3E, 0xC8, 0x6A, 0x64, 0x52, 0x1F, 0x2B, 0x18, 0x17, 0x7B, 0x20, 0x0C,
+        0xBB, 0xE1, 0x17, 0x57, 0x7A, 0x61, 0x5D, 0x6C, 0x77, 0x09, 0x88, 0xC0,
+        0xBA, 0xD9, 0x46, 0xE2, 0x08, 0xE2, 0x4F, 0xA0, 0x74, 0xE5, 0xAB, 0x31,
+        0x43, 0xDB, 0x5B, 0xFC, 0xE0, 0xFD, 0x10, 0x8E, 0x4B, 0x82, 0xD1, 0x20,
+        0xA9, 0x3A, 0xD2, 0xCA, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+/**
+ * SRP group generator g.
+ */
+static const uint8_t srpG = 5;
+
+/**
+ * SRP multiplier parameter k = SHA-512(N | PAD(g)).
+ */
+static const uint8_t srpK[SHA512_BYTES] = {
+        0xA9, 0xC2, 0xE2, 0x55, 0x9B, 0xF0, 0xEB, 0xB5, 0x3F, 0x0C, 0xBB, 0xF6,
+        0x22, 0x82, 0x90, 0x6B, 0xED, 0xE7, 0xF2, 0x18, 0x2F, 0x00, 0x67, 0x82,
+        0x11, 0xFB, 0xD5, 0xBD, 0xE5, 0xB2, 0x85, 0x03, 0x3A, 0x49, 0x93, 0x50,
+        0x3B, 0x87, 0x39, 0x7F, 0x9B, 0xE5, 0xEC, 0x02, 0x08, 0x0F, 0xED, 0xBC,
+        0x08, 0x35, 0x58, 0x7A, 0xD0, 0x39, 0x06, 0x08, 0x79, 0xB8, 0x62, 0x1E,
+        0x8C, 0x36, 0x59, 0xE0,
+};
+
+static struct {
+    /**
+     * Whether the group parameters have been loaded.
+     */
+    bool isInitialized;
+
+    mbedtls_mpi N;
+    mbedtls_mpi g;
+    mbedtls_mpi k;
+
+    /**
+     * Montgomery constant R^2 mod N. Filled in by the first mbedtls_mpi_exp_mod.
+     */
+    mbedtls_mpi RR;
+
+    /**
+     * Verifier that kv belongs to.
+     */
+    uint8_t v[SRP_VERIFIER_BYTES];
+
+    /**
+     * Whether kv is valid.
+     */
+    bool hasKV;
+
+    /**
+     * k * v mod N.
+     */
+    mbedtls_mpi kv;
+} srp;
+
+/**
+ * Aborts on mbedTLS errors. These can only be caused by running out of memory.
+ */
+#define MPI_CHECK(f) \
+    do { \
+        int e = (f); \
+        if (e) { \
+            HAPLogError(&logObject, "%s failed: %d.", #f, e); \
+            HAPFatalError(); \
+        } \
+    } while (0)
+
+/**
+ * Loads the group parameters.
+ */
+static void EnsureInitialized(void) {
+    if (srp.isInitialized) {
+        return;
+    }
+    mbedtls_mpi_init(&srp.N);
+    mbedtls_mpi_init(&srp.g);
+    mbedtls_mpi_init(&srp.k);
+    mbedtls_mpi_init(&srp.RR);
+    mbedtls_mpi_init(&srp.kv);
+    MPI_CHECK(mbedtls_mpi_read_binary(&srp.N, srpN, sizeof srpN));
+    MPI_CHECK(mbedtls_mpi_lset(&srp.g, srpG));
+    MPI_CHECK(mbedtls_mpi_read_binary(&srp.k, srpK, sizeof srpK));
+    srp.hasKV = false;
+    srp.isInitialized = true;
+}
+
+/**
+ * Returns k * v mod N, computing it if the verifier changed.
+ */
+HAP_RESULT_USE_CHECK
+static const mbedtls_mpi* GetKV(const uint8_t v[SRP_VERIFIER_BYTES]) {
+    if (!srp.hasKV || !HAPRawBufferAreEqual(srp.v, v, sizeof srp.v)) {
+        mbedtls_mpi t;
+        mbedtls_mpi_init(&t);
+        MPI_CHECK(mbedtls_mpi_read_binary(&t, v, SRP_VERIFIER_BYTES));
+        MPI_CHECK(mbedtls_mpi_mul_mpi(&t, &t, &srp.k));
+        MPI_CHECK(mbedtls_mpi_mod_mpi(&srp.kv, &t, &srp.N));
+        mbedtls_mpi_free(&t);
+        HAPRawBufferCopyBytes(srp.v, v, sizeof srp.v);
+        srp.hasKV = true;
+    }
+    return &srp.kv;
+}
+
+void __wrap_HAP_srp_public_key(
+        uint8_t pub_b[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]) {
+    HAPPrecondition(pub_b);
+    HAPPrecondition(priv_b);
+    HAPPrecondition(v);
+
+    EnsureInitialized();
+
+    mbedtls_mpi b, B;
+    mbedtls_mpi_init(&b);
+    mbedtls_mpi_init(&B);
+
+    // B = (k * v + g^b) % N
+    MPI_CHECK(mbedtls_mpi_read_binary(&b, priv_b, SRP_SECRET_KEY_BYTES));
+    MPI_CHECK(mbedtls_mpi_exp_mod(&B, &srp.g, &b, &srp.N, &srp.RR));
+    MPI_CHECK(mbedtls_mpi_add_mpi(&B, &B, GetKV(v)));
+    if (mbedtls_mpi_cmp_mpi(&B, &srp.N) >= 0) {
+        MPI_CHECK(mbedtls_mpi_sub_mpi(&B, &B, &srp.N));
+    }
+    MPI_CHECK(mbedtls_mpi_write_binary(&B, pub_b, SRP_PUBLIC_KEY_BYTES));
+
+    mbedtls_mpi_free(&b);
+    mbedtls_mpi_free(&B);
+}
+
+int __wrap_HAP_srp_premaster_secret(
+        uint8_t s[SRP_PREMASTER_SECRET_BYTES],
+        const uint8_t pub_a[SRP_PUBLIC_KEY_BYTES],
+        const uint8_t priv_b[SRP_SECRET_KEY_BYTES],
+        const uint8_t u[SRP_SCRAMBLING_PARAMETER_BYTES],
+        const uint8_t v[SRP_VERIFIER_BYTES]) {
+    HAPPrecondition(s);
+    HAPPrecondition(pub_a);
+    HAPPrecondition(priv_b);
+    HAPPrecondition(u);
+    HAPPrecondition(v);
+
+    EnsureInitialized();
+
+    int result = 0;
+    mbedtls_mpi A, b, U, V, S;
+    mbedtls_mpi_init(&A);
+    mbedtls_mpi_init(&b);
+    mbedtls_mpi_init(&U);
+    mbedtls_mpi_init(&V);
+    mbedtls_mpi_init(&S);
+
+    MPI_CHECK(mbedtls_mpi_read_binary(&A, pub_a, SRP_PUBLIC_KEY_BYTES));
+    MPI_CHECK(mbedtls_mpi_mod_mpi(&A, &A, &srp.N));
+    if (mbedtls_mpi_cmp_int(&A, 0) == 0) {
+        // RFC 5054, Section 2.5.4: The host MUST abort the authentication attempt if A % N is zero.
+        HAPLog(&logObject, "SRP public key A is invalid.");
+        result = 1;
+        goto cleanup;
+    }
+
+    // S = (A * v^u)^b % N
+    MPI_CHECK(mbedtls_mpi_read_binary(&b, priv_b, SRP_SECRET_KEY_BYTES));
+    MPI_CHECK(mbedtls_mpi_read_binary(&U, u, SRP_SCRAMBLING_PARAMETER_BYTES));
+    MPI_CHECK(mbedtls_mpi_read_binary(&V, v, SRP_VERIFIER_BYTES));
+    MPI_CHECK(mbedtls_mpi_exp_mod(&S, &V, &U, &srp.N, &srp.RR));
+    MPI_CHECK(mbedtls_mpi_mul_mpi(&S, &S, &A));
+    MPI_CHECK(mbedtls_mpi_mod_mpi(&S, &S, &srp.N));
+    MPI_CHECK(mbedtls_mpi_exp_mod(&S, &S, &b, &srp.N, &srp.RR));
+    MPI_CHECK(mbedtls_mpi_write_binary(&S, s, SRP_PREMASTER_SECRET_BYTES));
+
+cleanup:
+    mbedtls_mpi_free(&A);
+    mbedtls_mpi_free(&b);
+    mbedtls_mpi_free(&U);
+    mbedtls_mpi_free(&V);
+    mbedtls_mpi_free(&S);
+    return result;
+}
@@ -0,0 +1,517 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(ESP_PLATFORM)
+#include <sdkconfig.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "HAPPlatform.h"
+#include "HAPPlatformClock+Init.h"
+#include "HAPPlatformCrypto+Init.h"
+#include "HAPPlatformCrypto+Internal.h"
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "Crypto" };
+
+/**
+ * Frame size used for throughput measurements. Matches a typical HAP-IP frame.
+ */
+#define kBenchmarkFrameBytes ((size_t) 1024)
+
+/**
+ * Number of frames per throughput measurement.
+ */
+#define kBenchmarkNumFrames ((size_t) 32)
+
+#if defined(__XTENSA__) || defined(__x86_64__) || defined(__i386__)
+#define HAVE_CYCLE_COUNTER 1
+
+/**
+ * Reads the CPU cycle counter. Only differences of less than 2^32 cycles are meaningful.
+ */
+HAP_RESULT_USE_CHECK
+static uint32_t GetCycleCount(void) {
+#if defined(__XTENSA__)
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+#else
+    return (uint32_t) __rdtsc();
+#endif
+}
+#endif
+
+/**
+ * Logs throughput of a measurement.
+ *
+ * @param      name                 Name of the implementation.
+ * @param      numBytes             Number of bytes processed.
+ * @param      numCycles            Number of cycles, if a cycle counter is available.
+ * @param      duration             Duration in microseconds.
+ */
+static void LogThroughput(const char* name, size_t numBytes, uint32_t numCycles, uint64_t duration) {
+#if HAVE_CYCLE_COUNTER
+    uint64_t millibytesPerCycle = numCycles ? (uint64_t) numBytes * 1000 / numCycles : 0;
+    HAPLog(&logObject,
+           "%s: %lu.%03lu bytes/cycle, %lu KB/s.",
+           name,
+           (unsigned long) (millibytesPerCycle / 1000),
+           (unsigned long) (millibytesPerCycle % 1000),
+           (unsigned long) (duration ? (uint64_t) numBytes * 1000 / 1024 * 1000 / duration : 0));
+#else
+    (void) numCycles;
+    HAPLog(&logObject,
+           "%s: %lu KB/s.",
+           name,
+           (unsigned long) (duration ? (uint64_t) numBytes * 1000 / 1024 * 1000 / duration : 0));
+#endif
+}
+
+#if CONFIG_HAP_CRYPTO_CHACHA20_POLY1305
+
+typedef void (*EncryptFunction)(
+        uint8_t tag[CHACHA20_POLY1305_TAG_BYTES],
+        uint8_t* c,
+        const uint8_t* m,
+        size_t m_len,
+        const uint8_t* a,
+        size_t a_len,
+        const uint8_t* n,
+        size_t n_len,
+        const uint8_t k[CHACHA20_POLY1305_KEY_BYTES]);
+
+static void BenchmarkChaCha20Poly1305(const char* name, EncryptFunction encrypt, uint8_t* frame) {
+    uint8_t key[CHACHA20_POLY1305_KEY_BYTES];
+    uint8_t nonce[8];
+    uint8_t aad[2];
+    uint8_t tag[CHACHA20_POLY1305_TAG_BYTES];
+    HAPPlatformRandomNumberFill(key, sizeof key);
+    HAPRawBufferZero(nonce, sizeof nonce);
+    HAPWriteLittleUInt16(aad, kBenchmarkFrameBytes);
+
+    uint64_t startTime = HAPPlatformClockGetCurrentMicroseconds();
+#if HAVE_CYCLE_COUNTER
+    uint32_t startCycles = GetCycleCount();
+#endif
+    for (size_t i = 0; i < kBenchmarkNumFrames; i++) {
+        nonce[0] = (uint8_t) i;
+        encrypt(tag, frame, frame, kBenchmarkFrameBytes, aad, sizeof aad, nonce, sizeof nonce, key);
+    }
+#if HAVE_CYCLE_COUNTER
+    uint32_t numCycles = GetCycleCount() - startCycles;
+#else
+    uint32_t numCycles = 0;
+#endif
+    LogThroughput(
+            name,
+            kBenchmarkNumFrames * kBenchmarkFrameBytes,
+            numCycles,
+            HAPPlatformClockGetCurrentMicroseconds() - startTime);
+}
+
+/**
+ * Compares the optimized ChaCha20-Poly1305 with the mbedTLS implementation on random inputs.
+ */
+static void TestChaCha20Poly1305(void) {
+    static uint8_t m[kBenchmarkFrameBytes + 64];
+    static uint8_t c[2][sizeof m];
+    uint8_t a[32];
+    uint8_t k[CHACHA20_POLY1305_KEY_BYTES];
+    uint8_t n[12];
+    uint8_t tag[2][CHACHA20_POLY1305_TAG_BYTES];
+
+    for (size_t i = 0; i < 64; i++) {
+        size_t m_len;
+        HAPPlatformRandomNumberFill(&m_len, sizeof m_len);
+        m_len = i < 16 ? i : m_len % sizeof m;
+        size_t a_len = i % 3 ? i % sizeof a : 0;
+        size_t n_len = i % 2 ? 12 : 8;
+        HAPPlatformRandomNumberFill(m, m_len);
+        HAPPlatformRandomNumberFill(a, sizeof a);
+        HAPPlatformRandomNumberFill(k, sizeof k);
+        HAPPlatformRandomNumberFill(n, sizeof n);
+
+        __wrap_HAP_chacha20_poly1305_encrypt_aad(tag[0], c[0], m, m_len, a, a_len, n, n_len, k);
+        __real_HAP_chacha20_poly1305_encrypt_aad(tag[1], c[1], m, m_len, a, a_len, n, n_len, k);
+        if (!HAPRawBufferAreEqual(c[0], c[1], m_len) || !HAPRawBufferAreEqual(tag[0], tag[1], sizeof tag[0])) {
+            HAPLogError(&logObject, "ChaCha20-Poly1305 encryption mismatch (%zu bytes).", m_len);
+            HAPFatalError();
+        }
+        if (__wrap_HAP_chacha20_poly1305_decrypt_aad(tag[1], c[0], c[0], m_len, a, a_len, n, n_len, k) != 0 ||
+            !HAPRawBufferAreEqual(c[0], m, m_len)) {
+            HAPLogError(&logObject, "ChaCha20-Poly1305 decryption mismatch (%zu bytes).", m_len);
+            HAPFatalError();
+        }
+        tag[1][i % sizeof tag[1]] ^= 0x01;
+        if (__wrap_HAP_chacha20_poly1305_decrypt_aad(tag[1], c[1], c[1], m_len, a, a_len, n, n_len, k) == 0) {
+            HAPLogError(&logObject, "ChaCha20-Poly1305 accepted a modified tag.");
+            HAPFatalError();
+        }
+    }
+    HAPLog(&logObject, "ChaCha20-Poly1305 matches mbedTLS.");
+
+    BenchmarkChaCha20Poly1305("ChaCha20-Poly1305 (optimized)", __wrap_HAP_chacha20_poly1305_encrypt_aad, m);
+    BenchmarkChaCha20Poly1305("ChaCha20-Poly1305 (mbedTLS)", __real_HAP_chacha20_poly1305_encrypt_aad, m);
+}
+
+#endif
+
+#if CONFIG_HAP_CRYPTO_SRP
+
+/**
+ * Compares the SRP implementation with the mbedTLS one on random inputs and logs the duration of each step.
+ */
+static void TestSRP(void) {
+    static uint8_t v[SRP_VERIFIER_BYTES];
+    static uint8_t pub_a[SRP_PUBLIC_KEY_BYTES];
+    static uint8_t out[2][SRP_PREMASTER_SECRET_BYTES];
+    uint8_t priv_b[SRP_SECRET_KEY_BYTES];
+    uint8_t u[SRP_SCRAMBLING_PARAMETER_BYTES];
+    uint64_t durations[2][2] = { { 0 } };
+
+    // The verifier and the controller public key are random values below N (N starts with 64 one bits).
+    HAPPlatformRandomNumberFill(v, sizeof v);
+    v[0] &= 0x7F;
+    for (size_t i = 0; i < 4; i++) {
+        HAPPlatformRandomNumberFill(priv_b, sizeof priv_b);
+        HAPPlatformRandomNumberFill(pub_a, sizeof pub_a);
+        HAPPlatformRandomNumberFill(u, sizeof u);
+        pub_a[0] &= 0x7F;
+
+        uint64_t startTime = HAPPlatformClockGetCurrentMicroseconds();
+        __wrap_HAP_srp_public_key(out[0], priv_b, v);
+        durations[0][0] += HAPPlatformClockGetCurrentMicroseconds() - startTime;
+        startTime = HAPPlatformClockGetCurrentMicroseconds();
+        __real_HAP_srp_public_key(out[1], priv_b, v);
+        durations[1][0] += HAPPlatformClockGetCurrentMicroseconds() - startTime;
+        if (!HAPRawBufferAreEqual(out[0], out[1], SRP_PUBLIC_KEY_BYTES)) {
+            HAPLogError(&logObject, "SRP public key mismatch.");
+            HAPFatalError();
+        }
+
+        startTime = HAPPlatformClockGetCurrentMicroseconds();
+        int e0 = __wrap_HAP_srp_premaster_secret(out[0], pub_a, priv_b, u, v);
+        durations[0][1] += HAPPlatformClockGetCurrentMicroseconds() - startTime;
+        startTime = HAPPlatformClockGetCurrentMicroseconds();
+        int e1 = __real_HAP_srp_premaster_secret(out[1], pub_a, priv_b, u, v);
+        durations[1][1] += HAPPlatformClockGetCurrentMicroseconds() - startTime;
+        if (e0 || e1 || !HAPRawBufferAreEqual(out[0], out[1], SRP_PREMASTER_SECRET_BYTES)) {
+            HAPLogError(&logObject, "SRP premaster secret mismatch.");
+            HAPFatalError();
+        }
+    }
+    HAPRawBufferZero(pub_a, sizeof pub_a);
+    if (!__wrap_HAP_srp_premaster_secret(out[0], pub_a, priv_b, u, v)) {
+        HAPLogError(&logObject, "SRP accepted A = 0.");
+        HAPFatalError();
+    }
+    HAPLog(&logObject, "SRP matches mbedTLS.");
+
+    HAPLog(&logObject,
+           "SRP public key: %lu us (optimized), %lu us (mbedTLS).",
+           (unsigned long) (durations[0][0] / 4),
+           (unsigned long) (durations[1][0] / 4));
+    HAPLog(&logObject,
+           "SRP premaster secret: %lu us (optimized), %lu us (mbedTLS).",
+           (unsigned long) (durations[0][1] / 4),
+           (unsigned long) (durations[1][1] / 4));
+}
+
+#endif
+
+#if CONFIG_HAP_CRYPTO_CURVE25519
+
+/**
+ * X25519 and Ed25519 functions of one implementation.
+ */
+typedef struct {
+    const char* name;
+    void (*scalarmultBase)(uint8_t r[X25519_BYTES], const uint8_t n[X25519_SCALAR_BYTES]);
+    void (*scalarmult)(uint8_t r[X25519_BYTES], const uint8_t n[X25519_SCALAR_BYTES], const uint8_t p[X25519_BYTES]);
+    void (*publicKey)(uint8_t pk[ED25519_PUBLIC_KEY_BYTES], const uint8_t sk[ED25519_SECRET_KEY_BYTES]);
+    void (*sign)(
+            uint8_t sig[ED25519_BYTES],
+            const uint8_t* m,
+            size_t m_len,
+            const uint8_t sk[ED25519_SECRET_KEY_BYTES],
+            const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+    int (*verify)(
+            const uint8_t sig[ED25519_BYTES],
+            const uint8_t* m,
+            size_t m_len,
+            const uint8_t pk[ED25519_PUBLIC_KEY_BYTES]);
+} Curve25519Implementation;
+
+static const Curve25519Implementation curve25519Implementations[] = {
+    { .name = "optimized",
+      .scalarmultBase = __wrap_HAP_X25519_scalarmult_base,
+      .scalarmult = __wrap_HAP_X25519_scalarmult,
+      .publicKey = __wrap_HAP_ed25519_public_key,
+      .sign = __wrap_HAP_ed25519_sign,
+      .verify = __wrap_HAP_ed25519_verify },
+    { .name = "mbedTLS",
+      .scalarmultBase = __real_HAP_X25519_scalarmult_base,
+      .scalarmult = __real_HAP_X25519_scalarmult,
+      .publicKey = __real_HAP_ed25519_public_key,
+      .sign = __real_HAP_ed25519_sign,
+      .verify = __real_HAP_ed25519_verify },
+};
+
+/**
+ * Number of iterations per benchmark.
+ */
+#define kBenchmarkNumCurve25519Operations ((size_t) 4)
+
+/**
+ * Measures the accessory side of pair-verify: ephemeral key pair, shared secret, signature over the accessory info
+ * and verification of the controller signature.
+ */
+static void BenchmarkPairVerify(const Curve25519Implementation* implementation) {
+    uint8_t sk[ED25519_SECRET_KEY_BYTES];
+    uint8_t pk[ED25519_PUBLIC_KEY_BYTES];
+    uint8_t ephemeralSecretKey[X25519_SCALAR_BYTES];
+    uint8_t ephemeralPublicKey[X25519_BYTES];
+    uint8_t controllerPublicKey[X25519_BYTES];
+    uint8_t sharedSecret[X25519_BYTES];
+    uint8_t info[2 * X25519_BYTES + 17];
+    uint8_t signature[ED25519_BYTES];
+    HAPPlatformRandomNumberFill(sk, sizeof sk);
+    HAPPlatformRandomNumberFill(controllerPublicKey, sizeof controllerPublicKey);
+    HAPPlatformRandomNumberFill(info, sizeof info);
+    implementation->publicKey(pk, sk);
+    implementation->sign(signature, info, sizeof info, sk, pk);
+
+    uint64_t durations[4] = { 0 };
+    for (size_t i = 0; i < kBenchmarkNumCurve25519Operations; i++) {
+        HAPPlatformRandomNumberFill(ephemeralSecretKey, sizeof ephemeralSecretKey);
+        uint64_t t0 = HAPPlatformClockGetCurrentMicroseconds();
+        implementation->scalarmultBase(ephemeralPublicKey, ephemeralSecretKey);
+        uint64_t t1 = HAPPlatformClockGetCurrentMicroseconds();
+        implementation->scalarmult(sharedSecret, ephemeralSecretKey, controllerPublicKey);
+        uint64_t t2 = HAPPlatformClockGetCurrentMicroseconds();
+        implementation->sign(signature, info, sizeof info, sk, pk);
+        uint64_t t3 = HAPPlatformClockGetCurrentMicroseconds();
+        if (implementation->verify(signature, info, sizeof info, pk) != 0) {
+            HAPLogError(&logObject, "Ed25519 (%s) rejected a valid signature.", implementation->name);
+            HAPFatalError();
+        }
+        uint64_t t4 = HAPPlatformClockGetCurrentMicroseconds();
+        durations[0] += t1 - t0;
+        durations[1] += t2 - t1;
+        durations[2] += t3 - t2;
+        durations[3] += t4 - t3;
+    }
+    HAPLog(&logObject,
+           "Pair-verify (%s): %lu us (X25519 key pair %lu us, X25519 %lu us, Ed25519 sign %lu us, verify %lu us).",
+           implementation->name,
+           (unsigned long) ((durations[0] + durations[1] + durations[2] + durations[3]) /
+                            kBenchmarkNumCurve25519Operations),
+           (unsigned long) (durations[0] / kBenchmarkNumCurve25519Operations),
+           (unsigned long) (durations[1] / kBenchmarkNumCurve25519Operations),
+           (unsigned long) (durations[2] / kBenchmarkNumCurve25519Operations),
+           (unsigned long) (durations[3] / kBenchmarkNumCurve25519Operations));
+}
+
+/**
+ * Compares the X25519 and Ed25519 implementations with the mbedTLS ones on random inputs.
+ */
+static void TestCurve25519(void) {
+    const Curve25519Implementation* optimized = &curve25519Implementations[0];
+    const Curve25519Implementation* reference = &curve25519Implementations[1];
+
+    for (size_t i = 0; i < 16; i++) {
+        uint8_t n[X25519_SCALAR_BYTES];
+        uint8_t p[X25519_BYTES];
+        uint8_t r[2][X25519_BYTES];
+        HAPPlatformRandomNumberFill(n, sizeof n);
+        HAPPlatformRandomNumberFill(p, sizeof p);
+        p[31] &= 0x7F;
+        optimized->scalarmultBase(r[0], n);
+        reference->scalarmultBase(r[1], n);
+        if (!HAPRawBufferAreEqual(r[0], r[1], sizeof r[0])) {
+            HAPLogError(&logObject, "X25519 base point multiplication mismatch.");
+            HAPFatalError();
+        }
+        optimized->scalarmult(r[0], n, p);
+        reference->scalarmult(r[1], n, p);
+        if (!HAPRawBufferAreEqual(r[0], r[1], sizeof r[0])) {
+            HAPLogError(&logObject, "X25519 mismatch.");
+            HAPFatalError();
+        }
+
+        uint8_t sk[ED25519_SECRET_KEY_BYTES];
+        uint8_t pk[2][ED25519_PUBLIC_KEY_BYTES];
+        uint8_t m[64];
+        uint8_t sig[2][ED25519_BYTES];
+        size_t m_len = i * 4;
+        HAPPlatformRandomNumberFill(sk, sizeof sk);
+        HAPPlatformRandomNumberFill(m, m_len);
+        optimized->publicKey(pk[0], sk);
+        reference->publicKey(pk[1], sk);
+        if (!HAPRawBufferAreEqual(pk[0], pk[1], sizeof pk[0])) {
+            HAPLogError(&logObject, "Ed25519 public key mismatch.");
+            HAPFatalError();
+        }
+        optimized->sign(sig[0], m, m_len, sk, pk[0]);
+        reference->sign(sig[1], m, m_len, sk, pk[1]);
+        if (!HAPRawBufferAreEqual(sig[0], sig[1], sizeof sig[0])) {
+            HAPLogError(&logObject, "Ed25519 signature mismatch.");
+            HAPFatalError();
+        }
+        if (optimized->verify(sig[1], m, m_len, pk[0]) != 0) {
+            HAPLogError(&logObject, "Ed25519 rejected a valid signature.");
+            HAPFatalError();
+        }
+        sig[1][i % sizeof sig[1]] ^= 0x01;
+        if (optimized->verify(sig[1], m, m_len, pk[0]) == 0) {
+            HAPLogError(&logObject, "Ed25519 accepted a modified signature.");
+            HAPFatalError();
+        }
+    }
+    HAPLog(&logObject, "X25519 and Ed25519 match mbedTLS.");
+
+    for (size_t i = 0; i < HAPArrayCount(curve25519Implementations); i++) {
+        BenchmarkPairVerify(&curve25519Implementations[i]);
+    }
+}
+
+#endif
+
+#if CONFIG_HAP_CRYPTO_HKDF
+
+/**
+ * Number of derivations per HKDF measurement.
+ */
+#define kBenchmarkNumDerivations ((size_t) 64)
+
+typedef void (*HKDFFunction)(
+        uint8_t* r,
+        size_t r_len,
+        const uint8_t* key,
+        size_t key_len,
+        const uint8_t* salt,
+        size_t salt_len,
+        const uint8_t* info,
+        size_t info_len);
+
+/**
+ * Measures a pair-verify style session key derivation (32-byte key, salt and info strings, 32-byte output).
+ */
+static void BenchmarkHKDF(const char* name, HKDFFunction hkdf) {
+    static const char salt[] = "Control-Salt";
+    static const char info[] = "Control-Read-Encryption-Key";
+    uint8_t key[X25519_BYTES];
+    uint8_t r[CHACHA20_POLY1305_KEY_BYTES];
+    HAPPlatformRandomNumberFill(key, sizeof key);
+
+    uint64_t startTime = HAPPlatformClockGetCurrentMicroseconds();
+    for (size_t i = 0; i < kBenchmarkNumDerivations; i++) {
+        hkdf(r,
+             sizeof r,
+             key,
+             sizeof key,
+             (const uint8_t*) salt,
+             sizeof salt - 1,
+             (const uint8_t*) info,
+             sizeof info - 1);
+    }
+    uint64_t duration = HAPPlatformClockGetCurrentMicroseconds() - startTime;
+    HAPLog(&logObject,
+           "HKDF-SHA-512 (%s): %lu us.",
+           name,
+           (unsigned long) (duration / kBenchmarkNumDerivations));
+}
+
+/**
+ * Compares HMAC-SHA-512 and HKDF-SHA-512 with the mbedTLS implementations on random inputs.
+ */
+static void TestHKDF(void) {
+    static uint8_t frame[kBenchmarkFrameBytes];
+    uint8_t key[160];
+    uint8_t salt[80];
+    uint8_t info[80];
+    uint8_t r[2][200];
+
+    for (size_t i = 0; i < 32; i++) {
+        size_t key_len = (i * 37) % sizeof key;
+        size_t salt_len = (i * 13) % sizeof salt;
+        size_t info_len = (i * 7) % sizeof info;
+        size_t r_len = 1 + (i * 29) % sizeof r[0];
+        HAPPlatformRandomNumberFill(key, sizeof key);
+        HAPPlatformRandomNumberFill(salt, sizeof salt);
+        HAPPlatformRandomNumberFill(info, sizeof info);
+
+        __wrap_HAP_hmac_sha512(r[0], key, key_len, info, info_len);
+        __real_HAP_hmac_sha512(r[1], key, key_len, info, info_len);
+        if (!HAPRawBufferAreEqual(r[0], r[1], HMAC_SHA512_BYTES)) {
+            HAPLogError(&logObject, "HMAC-SHA-512 mismatch (%zu byte key).", key_len);
+            HAPFatalError();
+        }
+        __wrap_HAP_hkdf_sha512(r[0], r_len, key, key_len, salt, salt_len, info, info_len);
+        __real_HAP_hkdf_sha512(r[1], r_len, key, key_len, salt, salt_len, info, info_len);
+        if (!HAPRawBufferAreEqual(r[0], r[1], r_len)) {
+            HAPLogError(&logObject, "HKDF-SHA-512 mismatch (%zu bytes).", r_len);
+            HAPFatalError();
+        }
+    }
+    HAPLog(&logObject, "HMAC-SHA-512 and HKDF-SHA-512 match mbedTLS.");
+
+    uint8_t md[SHA512_BYTES];
+    HAPPlatformRandomNumberFill(frame, sizeof frame);
+    uint64_t startTime = HAPPlatformClockGetCurrentMicroseconds();
+#if HAVE_CYCLE_COUNTER
+    uint32_t startCycles = GetCycleCount();
+#endif
+    for (size_t i = 0; i < kBenchmarkNumFrames; i++) {
+        HAPPlatformCryptoSHA512(md, frame, sizeof frame, NULL, 0, NULL, 0);
+    }
+#if HAVE_CYCLE_COUNTER
+    uint32_t numCycles = GetCycleCount() - startCycles;
+#else
+    uint32_t numCycles = 0;
+#endif
+    LogThroughput(
+            "SHA-512",
+            kBenchmarkNumFrames * sizeof frame,
+            numCycles,
+            HAPPlatformClockGetCurrentMicroseconds() - startTime);
+
+    BenchmarkHKDF("optimized", __wrap_HAP_hkdf_sha512);
+    BenchmarkHKDF("mbedTLS", __real_HAP_hkdf_sha512);
+}
+
+#endif
+
+void HAPPlatformCryptoSelfTest(void) {
+#if CONFIG_HAP_CRYPTO_CHACHA20_POLY1305
+    TestChaCha20Poly1305();
+#endif
+#if CONFIG_HAP_CRYPTO_SRP
+    TestSRP();
+#endif
+#if CONFIG_HAP_CRYPTO_CURVE25519
+    TestCurve25519();
+#endif
+#if CONFIG_HAP_CRYPTO_HKDF
+    TestHKDF();
+#endif
+}
@@ -0,0 +1,432 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <driver/i2c.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "HAPPlatform.h"
+#include "HAPPlatformClock+Init.h"
+#include "HAPPlatformI2CBus+Init.h"
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "I2CBus" };
+
+#define kHAPPlatformI2CBus_Port I2C_NUM_0
+
+/**
+ * Time after which a single attempt is aborted in milliseconds.
+ */
+#define kHAPPlatformI2CBus_CommandTimeout ((uint32_t) 1000)
+
+#define kHAPPlatformI2CBus_TaskStackSize  ((uint32_t) 3072)
+#define kHAPPlatformI2CBus_TaskPriority   ((UBaseType_t) 7)
+
+static struct {
+    /** Protects the queue and the statistics. */
+    SemaphoreHandle_t _Nullable mutex;
+
+    /** Given whenever the queue changes. */
+    SemaphoreHandle_t _Nullable wakeUp;
+
+    /** Given by the worker task before it exits. */
+    SemaphoreHandle_t _Nullable stopped;
+
+    /** Wakes up the worker task when the next retry is due. Retry delays are often shorter than a tick. */
+    esp_timer_handle_t _Nullable retryTimer;
+
+    TaskHandle_t _Nullable task;
+
+    HAPPlatformI2CBusTransaction* _Nullable transactions;
+
+    uint64_t createTime;
+    HAPPlatformI2CBusStatistics statistics;
+
+    bool isInitialized : 1;
+    bool isStopping : 1;
+} bus;
+
+static void Lock(void) {
+    BaseType_t ok = xSemaphoreTake(bus.mutex, portMAX_DELAY);
+    HAPAssert(ok == pdTRUE);
+}
+
+static void Unlock(void) {
+    BaseType_t ok = xSemaphoreGive(bus.mutex);
+    HAPAssert(ok == pdTRUE);
+}
+
+/**
+ * Appends a transaction to the queue and wakes up the worker task.
+ */
+static void Enqueue(HAPPlatformI2CBusTransaction* transaction) {
+    HAPPrecondition(transaction);
+
+    transaction->next = NULL;
+    Lock();
+    HAPPlatformI2CBusTransaction** tail = &bus.transactions;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = transaction;
+    Unlock();
+    xSemaphoreGive(bus.wakeUp);
+}
+
+/**
+ * Returns whether transaction a should be started before transaction b.
+ */
+HAP_RESULT_USE_CHECK
+static bool IsBefore(const HAPPlatformI2CBusTransaction* a, const HAPPlatformI2CBusTransaction* b) {
+    if (a->priority != b->priority) {
+        return a->priority > b->priority;
+    }
+    if (a->deadline != b->deadline) {
+        return b->deadline == 0 || (a->deadline != 0 && a->deadline < b->deadline);
+    }
+    // Queue order.
+    return false;
+}
+
+/**
+ * Removes the next transaction to start from the queue.
+ *
+ * - Must be called with the mutex held.
+ *
+ * @param      now                  Current time in microseconds.
+ * @param[out] nextRetryTime        Earliest time at which a transaction that is waiting for a retry or its start
+ *                                  delay becomes ready, or 0 if there is none.
+ *
+ * @return Transaction to start, or NULL if none is ready.
+ */
+HAP_RESULT_USE_CHECK
+static HAPPlatformI2CBusTransaction* _Nullable DequeueLocked(uint64_t now, uint64_t* nextRetryTime) {
+    HAPPrecondition(nextRetryTime);
+
+    *nextRetryTime = 0;
+    HAPPlatformI2CBusTransaction** best = NULL;
+    for (HAPPlatformI2CBusTransaction** t = &bus.transactions; *t; t = &(*t)->next) {
+        if ((*t)->notBefore > now) {
+            if (!*nextRetryTime || (*t)->notBefore < *nextRetryTime) {
+                *nextRetryTime = (*t)->notBefore;
+            }
+            continue;
+        }
+        if (!best || IsBefore(*t, *best)) {
+            best = t;
+        }
+    }
+    if (!best) {
+        return NULL;
+    }
+    HAPPlatformI2CBusTransaction* transaction = *best;
+    *best = transaction->next;
+    transaction->next = NULL;
+    return transaction;
+}
+
+/**
+ * Issues one attempt of a transaction.
+ */
+HAP_RESULT_USE_CHECK
+static esp_err_t Execute(const HAPPlatformI2CBusTransaction* transaction) {
+    HAPPrecondition(transaction);
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (!cmd) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (transaction->numWriteBytes) {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (uint8_t)(transaction->address << 1), /* ack_en: */ true);
+        i2c_master_write(cmd, (uint8_t*) transaction->writeBytes, transaction->numWriteBytes, /* ack_en: */ true);
+    }
+    if (transaction->numReadBytes) {
+        // Repeated start if there was a write phase.
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (uint8_t)(transaction->address << 1 | 1), /* ack_en: */ true);
+        i2c_master_read(cmd, transaction->readBytes, transaction->numReadBytes, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(cmd);
+    esp_err_t ret =
+            i2c_master_cmd_begin(kHAPPlatformI2CBus_Port, cmd, pdMS_TO_TICKS(kHAPPlatformI2CBus_CommandTimeout));
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+static void HandleCompletionCallback(void* _Nullable context, size_t contextSize) {
+    HAPPrecondition(context);
+    HAPPrecondition(contextSize == sizeof(HAPPlatformI2CBusTransaction*));
+
+    HAPPlatformI2CBusTransaction* transaction = *(HAPPlatformI2CBusTransaction* const*) context;
+    HAPAssert(transaction->callback);
+    transaction->callback(transaction, transaction->error, transaction->context);
+}
+
+/**
+ * Completes a transaction.
+ */
+static void Complete(HAPPlatformI2CBusTransaction* transaction, HAPError error) {
+    HAPPrecondition(transaction);
+
+    uint64_t latency = HAPPlatformClockGetCurrentMicroseconds() - transaction->submitTime;
+    Lock();
+    bus.statistics.numTransactions++;
+    if (error) {
+        bus.statistics.numFailedTransactions++;
+    }
+    if (latency > bus.statistics.maxLatency) {
+        bus.statistics.maxLatency = latency;
+    }
+    Unlock();
+
+    transaction->error = error;
+    if (transaction->completed) {
+        // The transaction lives on the stack of the waiting task and must not be accessed after this.
+        xSemaphoreGive((SemaphoreHandle_t) transaction->completed);
+        return;
+    }
+    HAPError err = HAPPlatformRunLoopScheduleCallback(HandleCompletionCallback, &transaction, sizeof transaction);
+    if (err) {
+        HAPAssert(err == kHAPError_OutOfResources);
+        HAPLogError(&logObject, "Failed to schedule I2C transaction completion.");
+        HAPFatalError();
+    }
+}
+
+/**
+ * Worker task that owns the I2C driver.
+ */
+static void RunWorker(void* _Nullable context HAP_UNUSED) {
+    for (;;) {
+        uint64_t now = HAPPlatformClockGetCurrentMicroseconds();
+        uint64_t nextRetryTime;
+        Lock();
+        bool isStopping = bus.isStopping;
+        HAPPlatformI2CBusTransaction* transaction = DequeueLocked(now, &nextRetryTime);
+        Unlock();
+        if (isStopping) {
+            break;
+        }
+
+        if (!transaction) {
+            if (nextRetryTime) {
+                // Not rounded to ticks: NACK back-offs are 0.5 to 4 ms, a tick is typically 10 ms.
+                (void) esp_timer_stop(bus.retryTimer);
+                esp_err_t ret = esp_timer_start_once(bus.retryTimer, nextRetryTime - now);
+                HAPAssert(ret == ESP_OK);
+            }
+            (void) xSemaphoreTake(bus.wakeUp, portMAX_DELAY);
+            continue;
+        }
+
+        if (transaction->deadline && HAPPlatformClockGetCurrent() > transaction->deadline) {
+            HAPLog(&logObject, "Transaction to 0x%02X missed its deadline.", transaction->address);
+            Lock();
+            bus.statistics.numMissedDeadlines++;
+            Unlock();
+            Complete(transaction, kHAPError_Busy);
+            continue;
+        }
+
+        esp_err_t ret = Execute(transaction);
+        uint64_t duration = HAPPlatformClockGetCurrentMicroseconds() - now;
+        transaction->numAttempts++;
+        Lock();
+        bus.statistics.busyDuration += duration;
+        Unlock();
+
+        if (ret != ESP_OK && transaction->numAttempts < HAPMax(transaction->maxAttempts, 1)) {
+            // The device is busy. Let other devices use the bus in the meantime.
+            transaction->notBefore = HAPPlatformClockGetCurrentMicroseconds() + transaction->retryDelay;
+            Lock();
+            bus.statistics.numRetries++;
+            Unlock();
+            Enqueue(transaction);
+            continue;
+        }
+        if (ret != ESP_OK) {
+            HAPLog(&logObject,
+                   "Transaction to 0x%02X failed after %u attempts: %d.",
+                   transaction->address,
+                   transaction->numAttempts,
+                   ret);
+        }
+        Complete(transaction, ret == ESP_OK ? kHAPError_None : kHAPError_Unknown);
+    }
+
+    xSemaphoreGive(bus.stopped);
+    vTaskDelete(NULL);
+}
+
+static void HandleRetryTimerExpired(void* _Nullable context HAP_UNUSED) {
+    // Called on the esp_timer task.
+    xSemaphoreGive(bus.wakeUp);
+}
+
+void HAPPlatformI2CBusCreate(const HAPPlatformI2CBusOptions* options) {
+    HAPPrecondition(options);
+    HAPPrecondition(!bus.isInitialized);
+
+    i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = options->sdaGPIO,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_io_num = options->sclGPIO,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = options->clockSpeed,
+    };
+    esp_err_t ret = i2c_param_config(kHAPPlatformI2CBus_Port, &conf);
+    if (ret != ESP_OK) {
+        HAPLogError(&logObject, "i2c_param_config failed: %d.", ret);
+        HAPFatalError();
+    }
+    ret = i2c_driver_install(kHAPPlatformI2CBus_Port, conf.mode, 0, 0, 0);
+    if (ret != ESP_OK) {
+        HAPLogError(&logObject, "i2c_driver_install failed: %d.", ret);
+        HAPFatalError();
+    }
+
+    bus.mutex = xSemaphoreCreateMutex();
+    bus.wakeUp = xSemaphoreCreateBinary();
+    bus.stopped = xSemaphoreCreateBinary();
+    if (!bus.mutex || !bus.wakeUp || !bus.stopped) {
+        HAPLogError(&logObject, "Failed to create I2C bus semaphores.");
+        HAPFatalError();
+    }
+    ret = esp_timer_create(
+            &(const esp_timer_create_args_t) { .callback = HandleRetryTimerExpired, .name = "i2c_bus_retry" },
+            &bus.retryTimer);
+    if (ret != ESP_OK) {
+        HAPLogError(&logObject, "esp_timer_create failed: %d.", ret);
+        HAPFatalError();
+    }
+    bus.transactions = NULL;
+    bus.createTime = HAPPlatformClockGetCurrentMicroseconds();
+    HAPRawBufferZero(&bus.statistics, sizeof bus.statistics);
+    bus.isStopping = false;
+    bus.isInitialized = true;
+
+    BaseType_t ok = xTaskCreate(
+            RunWorker, "i2c_bus", kHAPPlatformI2CBus_TaskStackSize, NULL, kHAPPlatformI2CBus_TaskPriority, &bus.task);
+    if (ok != pdPASS) {
+        HAPLogError(&logObject, "Failed to create I2C bus task.");
+        HAPFatalError();
+    }
+}
+
+void HAPPlatformI2CBusRelease(void) {
+    HAPPrecondition(bus.isInitialized);
+    HAPPrecondition(!bus.transactions);
+
+    Lock();
+    bus.isStopping = true;
+    Unlock();
+    xSemaphoreGive(bus.wakeUp);
+    (void) xSemaphoreTake(bus.stopped, portMAX_DELAY);
+
+    (void) esp_timer_stop(bus.retryTimer);
+    esp_err_t ret = esp_timer_delete(bus.retryTimer);
+    HAPAssert(ret == ESP_OK);
+
+    ret = i2c_driver_delete(kHAPPlatformI2CBus_Port);
+    if (ret != ESP_OK) {
+        HAPLogError(&logObject, "i2c_driver_delete failed: %d.", ret);
+    }
+
+    vSemaphoreDelete(bus.stopped);
+    vSemaphoreDelete(bus.wakeUp);
+    vSemaphoreDelete(bus.mutex);
+    HAPRawBufferZero(&bus, sizeof bus);
+}
+
+/**
+ * Prepares a transaction for submission.
+ */
+static void Prepare(HAPPlatformI2CBusTransaction* transaction) {
+    HAPPrecondition(bus.isInitialized);
+    HAPPrecondition(transaction);
+    HAPPrecondition(transaction->address < 0x80);
+    HAPPrecondition(transaction->numWriteBytes || transaction->numReadBytes);
+    HAPPrecondition(!transaction->numWriteBytes || transaction->writeBytes);
+    HAPPrecondition(!transaction->numReadBytes || transaction->readBytes);
+
+    transaction->completed = NULL;
+    transaction->submitTime = HAPPlatformClockGetCurrentMicroseconds();
+    transaction->notBefore = transaction->startDelay ? transaction->submitTime + transaction->startDelay : 0;
+    transaction->numAttempts = 0;
+    transaction->error = kHAPError_None;
+}
+
+void HAPPlatformI2CBusSubmit(HAPPlatformI2CBusTransaction* transaction) {
+    HAPPrecondition(transaction);
+    HAPPrecondition(transaction->callback);
+
+    Prepare(transaction);
+    Enqueue(transaction);
+}
+
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformI2CBusPerform(HAPPlatformI2CBusTransaction* transaction) {
+    HAPPrecondition(transaction);
+    HAPPrecondition(!transaction->callback);
+    HAPPrecondition(xTaskGetCurrentTaskHandle() != bus.task);
+
+    // A dedicated semaphore, so that task notifications sent to the caller by others cannot end the wait early.
+    StaticSemaphore_t completedBuffer;
+    SemaphoreHandle_t completed = xSemaphoreCreateBinaryStatic(&completedBuffer);
+    HAPAssert(completed);
+
+    Prepare(transaction);
+    transaction->completed = completed;
+    Enqueue(transaction);
+    while (xSemaphoreTake(completed, portMAX_DELAY) != pdTRUE) {
+    }
+    vSemaphoreDelete(completed);
+    return transaction->error;
+}
+
+void HAPPlatformI2CBusGetStatistics(HAPPlatformI2CBusStatistics* statistics) {
+    HAPPrecondition(bus.isInitialized);
+    HAPPrecondition(statistics);
+
+    Lock();
+    *statistics = bus.statistics;
+    Unlock();
+    statistics->duration = HAPPlatformClockGetCurrentMicroseconds() - bus.createTime;
+}
+
+void HAPPlatformI2CBusLogStatistics(void) {
+    HAPPlatformI2CBusStatistics statistics;
+    HAPPlatformI2CBusGetStatistics(&statistics);
+
+    HAPLogInfo(
+            &logObject,
+            "I2C bus: %lu.%02lu%% utilization, %lu transactions (%lu failed, %lu retries, %lu missed deadlines), "
+            "max latency %llu us.",
+            (unsigned long) (statistics.duration ? statistics.busyDuration * 100 / statistics.duration : 0),
+            (unsigned long) (statistics.duration ? statistics.busyDuration * 10000 / statistics.duration % 100 : 0),
+            (unsigned long) statistics.numTransactions,
+            (unsigned long) statistics.numFailedTransactions,
+            (unsigned long) statistics.numRetries,
+            (unsigned long) statistics.numMissedDeadlines,
+            (unsigned long long) statistics.maxLatency);
+}
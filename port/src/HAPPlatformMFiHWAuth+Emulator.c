@@ -0,0 +1,419 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Software emulation of the Apple Authentication Coprocessor 3.0 register interface.
+//
+// The emulator signs challenges with a built-in test key. Its certificate is self-signed and not issued by Apple, so
+// controllers reject it. It is meant for profiling the accessory side of pair setup without coprocessor hardware.
+// Timings follow a configurable latency model.
+
+#include <unistd.h>
+
+#if defined(ESP_PLATFORM)
+#include <sdkconfig.h>
+#endif
+#include <mbedtls/ecdsa.h>
+
+#include "HAP+Internal.h"
+#include "HAPPlatformClock+Init.h"
+#include "HAPPlatformMFiHWAuth+Init.h"
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "MFiHWAuthEmulator" };
+
+#ifndef CONFIG_HAP_MFI_HW_AUTH_EMULATOR_SIGNATURE_TIME
+#define CONFIG_HAP_MFI_HW_AUTH_EMULATOR_SIGNATURE_TIME 180
+#endif
+
+#ifndef CONFIG_HAP_IC2_SPEED
+#define CONFIG_HAP_IC2_SPEED 400000
+#endif
+
+#define AUTH_REG_DEVICE_VERSION         0x00
+#define AUTH_REG_AUTH_REVISION          0x01
+#define AUTH_REG_PROTOCOL_MAJOR         0x02
+#define AUTH_REG_PROTOCOL_MINOR         0x03
+#define AUTH_REG_DEVICE_ID              0x04
+#define AUTH_REG_ERROR_CODE             0x05
+#define AUTH_REG_CONTROL_STATUS         0x10
+#define AUTH_REG_SIGNATURE_LENGTH       0x11
+#define AUTH_REG_SIGNATURE_DATA         0x12
+#define AUTH_REG_CHALLENGE_LENGTH       0x20
+#define AUTH_REG_CHALLENGE_DATA         0x21
+#define AUTH_REG_CERTIFICATE_LENGTH     0x30
+#define AUTH_REG_CERTIFICATE_DATA_1     0x31
+#define AUTH_REG_CERTIFICATE_DATA_10    0x3A
+#define AUTH_REG_SLEEP                  0x60
+
+#define AUTH_CONTROL_START_SIGNATURE    0x01
+#define AUTH_STATUS_SIGNATURE_OK        0x10
+
+#define AUTH_ERROR_INVALID_READ         0x01
+#define AUTH_ERROR_INVALID_WRITE        0x02
+#define AUTH_ERROR_INVALID_CHALLENGE    0x04
+#define AUTH_ERROR_INTERNAL             0x06
+#define AUTH_ERROR_INVALID_CONTROL      0x07
+
+/**
+ * Self-signed test certificate (CN=MFi Emulator Test Only). Not issued by Apple.
+ */
+static const uint8_t certificateBytes[] = {
+    0x30, 0x82, 0x01, 0x87, 0x30, 0x82, 0x01, 0x2C, 0xA0, 0x03, 0x02, 0x01,
+    0x02, 0x02, 0x01, 0x01, 0x30, 0x0A, 0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE,
+    0x3D, 0x04, 0x03, 0x02, 0x30, 0x21, 0x31, 0x1F, 0x30, 0x1D, 0x06, 0x03,
+    0x55, 0x04, 0x03, 0x0C, 0x16, 0x4D, 0x46, 0x69, 0x20, 0x45, 0x6D, 0x75,
+    0x6C, 0x61, 0x74, 0x6F, 0x72, 0x20, 0x54, 0x65, 0x73, 0x74, 0x20, 0x4F,
+    0x6E, 0x6C, 0x79, 0x30, 0x20, 0x17, 0x0D, 0x32, 0x36, 0x31, 0x30, 0x31,
+    0x38, 0x31, 0x38, 0x32, 0x31, 0x31, 0x34, 0x5A, 0x18, 0x0F, 0x32, 0x31,
+    0x32, 0x36, 0x30, 0x39, 0x32, 0x34, 0x31, 0x38, 0x32, 0x31, 0x31, 0x34,
+    0x5A, 0x30, 0x21, 0x31, 0x1F, 0x30, 0x1D, 0x06, 0x03, 0x55, 0x04, 0x03,
+    0x0C, 0x16, 0x4D, 0x46, 0x69, 0x20, 0x45, 0x6D, 0x75, 0x6C, 0x61, 0x74,
+    0x6F, 0x72, 0x20, 0x54, 0x65, 0x73, 0x74, 0x20, 0x4F, 0x6E, 0x6C, 0x79,
+    0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x02,
+    0x01, 0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x03, 0x01, 0x07, 0x03,
+    0x42, 0x00, 0x04, 0x2E, 0xCB, 0x06, 0x6C, 0xAB, 0xDB, 0x75, 0xFF, 0x08,
+    0x4F, 0xDE, 0xC7, 0xA0, 0x57, 0xE6, 0xB7, 0xE1, 0x46, 0x94, 0x1F, 0x10,
+    0xB9, 0xAA, 0xE2, 0x00, 0x9E, 0x53, 0x14, 0x9A, 0x69, 0x8C, 0xAC, 0x86,
+    0x80, 0xE7, 0x37, 0x37, 0xFF, 0xEA, 0x8A, 0x9F, 0x20, 0xBA, 0x2A, 0x81,
+    0xE9, 0x56, 0xEA, 0xEF, 0xF9, 0x7D, 0x1D, 0xD3, 0x5D, 0xB1, 0x8B, 0x6B,
+    0xA2, 0xCE, 0xDF, 0x73, 0xB2, 0x07, 0x85, 0xA3, 0x53, 0x30, 0x51, 0x30,
+    0x1D, 0x06, 0x03, 0x55, 0x1D, 0x0E, 0x04, 0x16, 0x04, 0x14, 0x0F, 0xCF,
+    0x15, 0x51, 0xEC, 0xFF, 0xED, 0xB0, 0x4F, 0x78, 0x31, 0x14, 0x9C, 0xA6,
+    0x22, 0x2A, 0x6E, 0x9A, 0x78, 0xBF, 0x30, 0x1F, 0x06, 0x03, 0x55, 0x1D,
+    0x23, 0x04, 0x18, 0x30, 0x16, 0x80, 0x14, 0x0F, 0xCF, 0x15, 0x51, 0xEC,
+    0xFF, 0xED, 0xB0, 0x4F, 0x78, 0x31, 0x14, 0x9C, 0xA6, 0x22, 0x2A, 0x6E,
+    0x9A, 0x78, 0xBF, 0x30, 0x0F, 0x06, 0x03, 0x55, 0x1D, 0x13, 0x01, 0x01,
+    0xFF, 0x04, 0x05, 0x30, 0x03, 0x01, 0x01, 0xFF, 0x30, 0x0A, 0x06, 0x08,
+    0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x04, 0x03, 0x02, 0x03, 0x49, 0x00, 0x30,
+    0x46, 0x02, 0x21, 0x00, 0xBD, 0xEB, 0x2C, 0xA5, 0x30, 0x08, 0x61, 0xA7,
+    0xA1, 0x48, 0x68, 0xFA, 0x38, 0x96, 0x60, 0xAA, 0x34, 0xBF, 0x92, 0x60,
+    0xAC, 0x19, 0xFB, 0xA1, 0x80, 0xDB, 0x83, 0x9E, 0x1B, 0x47, 0xCB, 0xFF,
+    0x02, 0x21, 0x00, 0xEC, 0x70, 0xCF, 0x6D, 0x74, 0x54, 0x55, 0x54, 0x38,
+    0x3B, 0x19, 0xA9, 0x18, 0xEB, 0x70, 0x7D, 0x4A, 0x15, 0xC1, 0xFD, 0x38,
+    0x58, 0xCE, 0x4F, 0xC8, 0xEE, 0x2D, 0xB9, 0x6B, 0x51, 0xA9, 0x2F,
+};
+
+/**
+ * NIST P-256 private key matching certificateBytes. Test only.
+ */
+static const uint8_t privateKeyBytes[] = {
+    0x8E, 0x6A, 0x1E, 0x96, 0xB6, 0xBD, 0x7D, 0x16, 0x12, 0x98, 0x41, 0xD6,
+    0x5C, 0xFE, 0x3B, 0x1A, 0x0E, 0xB7, 0x46, 0x77, 0xBF, 0x06, 0x51, 0xF9,
+    0xC1, 0x39, 0xAC, 0xD7, 0x40, 0xAD, 0xA6, 0xBF,
+};
+
+/**
+ * Blocks the calling task for the given number of microseconds.
+ */
+static void Wait(uint64_t duration) {
+    while (duration) {
+        useconds_t chunk = (useconds_t) HAPMin(duration, (uint64_t) 500000);
+        (void) usleep(chunk);
+        duration -= chunk;
+    }
+}
+
+/**
+ * Emulates the bus time of a transaction. Waits for a pending signature first, as the I2C driver does by retrying
+ * while the coprocessor NACKs.
+ */
+static void EmulateTransaction(HAPPlatformMFiHWAuthRef mfiHWAuth, size_t numBytes) {
+    HAPPrecondition(mfiHWAuth);
+
+    uint64_t startTime = HAPPlatformClockGetCurrentMicroseconds();
+    uint64_t now = startTime;
+    if (mfiHWAuth->busyUntil > now) {
+        Wait(mfiHWAuth->busyUntil - now);
+    }
+    const HAPPlatformMFiHWAuthEmulatorLatencyModel* model = &mfiHWAuth->latencyModel;
+    uint64_t transferDuration = model->transactionDuration;
+    if (model->clockSpeed) {
+        // Address and register bytes plus payload.
+        transferDuration += (uint64_t)(numBytes + 2) * 9 * 1000000 / model->clockSpeed;
+    }
+    Wait(transferDuration);
+
+    mfiHWAuth->numTransactions++;
+    mfiHWAuth->transactionDuration += HAPPlatformClockGetCurrentMicroseconds() - startTime;
+}
+
+static int FillRandom(void* _Nullable context HAP_UNUSED, unsigned char* bytes, size_t numBytes) {
+    HAPPlatformRandomNumberFill(bytes, numBytes);
+    return 0;
+}
+
+/**
+ * Signs the challenge with the test key. The signature is the raw concatenation of r and s.
+ */
+HAP_RESULT_USE_CHECK
+static HAPError GenerateSignature(HAPPlatformMFiHWAuthRef mfiHWAuth) {
+    HAPPrecondition(mfiHWAuth);
+
+    mbedtls_ecp_group group;
+    mbedtls_mpi d, r, s;
+    mbedtls_ecp_group_init(&group);
+    mbedtls_mpi_init(&d);
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+
+    int ret = mbedtls_ecp_group_load(&group, MBEDTLS_ECP_DP_SECP256R1);
+    if (!ret) {
+        ret = mbedtls_mpi_read_binary(&d, privateKeyBytes, sizeof privateKeyBytes);
+    }
+    if (!ret) {
+        ret = mbedtls_ecdsa_sign(
+                &group,
+                &r,
+                &s,
+                &d,
+                mfiHWAuth->challengeBytes,
+                mfiHWAuth->numChallengeBytes,
+                FillRandom,
+                NULL);
+    }
+    if (!ret) {
+        ret = mbedtls_mpi_write_binary(&r, &mfiHWAuth->signatureBytes[0], 32);
+    }
+    if (!ret) {
+        ret = mbedtls_mpi_write_binary(&s, &mfiHWAuth->signatureBytes[32], 32);
+    }
+
+    mbedtls_mpi_free(&s);
+    mbedtls_mpi_free(&r);
+    mbedtls_mpi_free(&d);
+    mbedtls_ecp_group_free(&group);
+
+    if (ret) {
+        HAPLogError(&logObject, "Signature generation failed: %d.", ret);
+        return kHAPError_Unknown;
+    }
+    return kHAPError_None;
+}
+
+static void HandleControlWrite(HAPPlatformMFiHWAuthRef mfiHWAuth, uint8_t value) {
+    HAPPrecondition(mfiHWAuth);
+
+    if (value != AUTH_CONTROL_START_SIGNATURE) {
+        mfiHWAuth->errorCode = AUTH_ERROR_INVALID_CONTROL;
+        return;
+    }
+    if (mfiHWAuth->numChallengeBytes != sizeof mfiHWAuth->challengeBytes) {
+        mfiHWAuth->errorCode = AUTH_ERROR_INVALID_CHALLENGE;
+        return;
+    }
+
+    uint64_t startTime = HAPPlatformClockGetCurrentMicroseconds();
+    HAPError err = GenerateSignature(mfiHWAuth);
+    if (err) {
+        mfiHWAuth->status = 0;
+        mfiHWAuth->errorCode = AUTH_ERROR_INTERNAL;
+        return;
+    }
+    mfiHWAuth->status = AUTH_STATUS_SIGNATURE_OK;
+    mfiHWAuth->busyUntil = startTime + mfiHWAuth->latencyModel.signatureDuration;
+}
+
+void HAPPlatformMFiHWAuthCreate(HAPPlatformMFiHWAuthRef mfiHWAuth) {
+    HAPPrecondition(mfiHWAuth);
+    HAP_STATIC_ASSERT(sizeof certificateBytes <= 10 * 128, certificateBytes);
+
+    HAPRawBufferZero(mfiHWAuth, sizeof *mfiHWAuth);
+    mfiHWAuth->latencyModel = (HAPPlatformMFiHWAuthEmulatorLatencyModel) {
+        .clockSpeed = CONFIG_HAP_IC2_SPEED,
+        .transactionDuration = 100,
+        .signatureDuration = CONFIG_HAP_MFI_HW_AUTH_EMULATOR_SIGNATURE_TIME * 1000
+    };
+    HAPLog(&logObject, "Emulating the Apple Authentication Coprocessor. Controllers will reject its certificate.");
+}
+
+void HAPPlatformMFiHWAuthRelease(HAPPlatformMFiHWAuthRef mfiHWAuth) {
+    HAPPrecondition(mfiHWAuth);
+
+    HAPRawBufferZero(mfiHWAuth, sizeof *mfiHWAuth);
+}
+
+void HAPPlatformMFiHWAuthEmulatorSetLatencyModel(
+        HAPPlatformMFiHWAuthRef mfiHWAuth,
+        const HAPPlatformMFiHWAuthEmulatorLatencyModel* latencyModel) {
+    HAPPrecondition(mfiHWAuth);
+    HAPPrecondition(latencyModel);
+
+    mfiHWAuth->latencyModel = *latencyModel;
+}
+
+HAP_RESULT_USE_CHECK
+bool HAPPlatformMFiHWAuthIsPoweredOn(HAPPlatformMFiHWAuthRef mfiHWAuth) {
+    HAPPrecondition(mfiHWAuth);
+
+    return mfiHWAuth->poweredOn;
+}
+
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformMFiHWAuthPowerOn(HAPPlatformMFiHWAuthRef mfiHWAuth) {
+    HAPPrecondition(mfiHWAuth);
+
+    mfiHWAuth->poweredOn = true;
+    mfiHWAuth->powerOnTime = HAPPlatformClockGetCurrentMicroseconds();
+    mfiHWAuth->numTransactions = 0;
+    mfiHWAuth->transactionDuration = 0;
+    return kHAPError_None;
+}
+
+void HAPPlatformMFiHWAuthPowerOff(HAPPlatformMFiHWAuthRef mfiHWAuth) {
+    HAPPrecondition(mfiHWAuth);
+
+    if (mfiHWAuth->poweredOn) {
+        HAPLogInfo(
+                &logObject,
+                "Coprocessor session: %lu transactions, %llu ms in transactions, %llu ms powered on.",
+                (unsigned long) mfiHWAuth->numTransactions,
+                (unsigned long long) (mfiHWAuth->transactionDuration / 1000),
+                (unsigned long long) ((HAPPlatformClockGetCurrentMicroseconds() - mfiHWAuth->powerOnTime) / 1000));
+    }
+    mfiHWAuth->poweredOn = false;
+    mfiHWAuth->busyUntil = 0;
+    mfiHWAuth->numChallengeBytes = 0;
+    mfiHWAuth->status = 0;
+    mfiHWAuth->errorCode = 0;
+}
+
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformMFiHWAuthWrite(HAPPlatformMFiHWAuthRef mfiHWAuth, const void* bytes_, size_t numBytes) {
+    HAPPrecondition(mfiHWAuth);
+    HAPPrecondition(bytes_);
+    HAPPrecondition(numBytes >= 1 && numBytes <= 128);
+    const uint8_t* bytes = bytes_;
+
+    if (!HAPPlatformMFiHWAuthIsPoweredOn(mfiHWAuth)) {
+        return kHAPError_InvalidState;
+    }
+    EmulateTransaction(mfiHWAuth, numBytes);
+
+    // The register address auto-increments while writing.
+    uint8_t registerAddress = bytes[0];
+    const uint8_t* data = &bytes[1];
+    size_t numDataBytes = numBytes - 1;
+    bool wroteChallengeLength = false;
+    if (registerAddress == AUTH_REG_CHALLENGE_LENGTH && numDataBytes >= 2) {
+        mfiHWAuth->numChallengeBytes = HAPReadBigUInt16(data);
+        wroteChallengeLength = true;
+        data += 2;
+        numDataBytes -= 2;
+        registerAddress = AUTH_REG_CHALLENGE_DATA;
+    }
+    if (!numDataBytes) {
+        return kHAPError_None;
+    }
+    switch (registerAddress) {
+        case AUTH_REG_CONTROL_STATUS: {
+            HandleControlWrite(mfiHWAuth, data[0]);
+        } break;
+        case AUTH_REG_CHALLENGE_DATA: {
+            if (numDataBytes > sizeof mfiHWAuth->challengeBytes) {
+                mfiHWAuth->errorCode = AUTH_ERROR_INVALID_CHALLENGE;
+                break;
+            }
+            HAPRawBufferCopyBytes(mfiHWAuth->challengeBytes, data, numDataBytes);
+            if (!wroteChallengeLength) {
+                mfiHWAuth->numChallengeBytes = (uint16_t) numDataBytes;
+            }
+        } break;
+        case AUTH_REG_SLEEP: {
+            HAPLogDebug(&logObject, "Sleep requested.");
+        } break;
+        default: {
+            HAPLog(&logObject, "Write to read-only register 0x%02X.", registerAddress);
+            mfiHWAuth->errorCode = AUTH_ERROR_INVALID_WRITE;
+        } break;
+    }
+    return kHAPError_None;
+}
+
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformMFiHWAuthRead(
+        HAPPlatformMFiHWAuthRef mfiHWAuth,
+        uint8_t registerAddress,
+        void* bytes,
+        size_t numBytes) {
+    HAPPrecondition(mfiHWAuth);
+    HAPPrecondition(bytes);
+    HAPPrecondition(numBytes >= 1 && numBytes <= 128);
+
+    if (!HAPPlatformMFiHWAuthIsPoweredOn(mfiHWAuth)) {
+        return kHAPError_InvalidState;
+    }
+    EmulateTransaction(mfiHWAuth, numBytes);
+
+    // Bytes past the end of a register read as zero.
+    uint8_t value[128];
+    HAPRawBufferZero(value, sizeof value);
+    switch (registerAddress) {
+        case AUTH_REG_DEVICE_VERSION: {
+            value[0] = 0x07;
+        } break;
+        case AUTH_REG_AUTH_REVISION: {
+            value[0] = 0x01;
+        } break;
+        case AUTH_REG_PROTOCOL_MAJOR: {
+            value[0] = 0x03;
+        } break;
+        case AUTH_REG_PROTOCOL_MINOR: {
+            value[0] = 0x00;
+        } break;
+        case AUTH_REG_DEVICE_ID: {
+            HAPWriteBigUInt32(value, 0x00000300);
+        } break;
+        case AUTH_REG_ERROR_CODE: {
+            value[0] = mfiHWAuth->errorCode;
+            mfiHWAuth->errorCode = 0;
+        } break;
+        case AUTH_REG_CONTROL_STATUS: {
+            value[0] = mfiHWAuth->status;
+        } break;
+        case AUTH_REG_SIGNATURE_LENGTH: {
+            HAPWriteBigUInt16(value, sizeof mfiHWAuth->signatureBytes);
+        } break;
+        case AUTH_REG_SIGNATURE_DATA: {
+            HAPRawBufferCopyBytes(value, mfiHWAuth->signatureBytes, sizeof mfiHWAuth->signatureBytes);
+        } break;
+        case AUTH_REG_CHALLENGE_LENGTH: {
+            HAPWriteBigUInt16(value, mfiHWAuth->numChallengeBytes);
+        } break;
+        case AUTH_REG_CHALLENGE_DATA: {
+            HAPRawBufferCopyBytes(value, mfiHWAuth->challengeBytes, sizeof mfiHWAuth->challengeBytes);
+        } break;
+        case AUTH_REG_CERTIFICATE_LENGTH: {
+            HAPWriteBigUInt16(value, sizeof certificateBytes);
+        } break;
+        default: {
+            if (registerAddress >= AUTH_REG_CERTIFICATE_DATA_1 && registerAddress <= AUTH_REG_CERTIFICATE_DATA_10) {
+                size_t offset = (size_t)(registerAddress - AUTH_REG_CERTIFICATE_DATA_1) * 128;
+                if (offset < sizeof certificateBytes) {
+                    HAPRawBufferCopyBytes(
+                            value, &certificateBytes[offset], HAPMin(sizeof certificateBytes - offset, sizeof value));
+                }
+                break;
+            }
+            HAPLog(&logObject, "Read from unsupported register 0x%02X.", registerAddress);
+            mfiHWAuth->errorCode = AUTH_ERROR_INVALID_READ;
+        } break;
+    }
+    HAPRawBufferCopyBytes(bytes, value, numBytes);
+    return kHAPError_None;
+}
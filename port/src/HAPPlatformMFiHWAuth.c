@@ -19,178 +19,159 @@
 // limitations under the License.
 
 #include "HAP+Internal.h"
+#include "HAPPlatformClock+Init.h"
+#include "HAPPlatformI2CBus+Init.h"
 #include "HAPPlatformMFiHWAuth+Init.h"
-#include <esp_err.h>
-#include "driver/i2c.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "MFiHWAuth" };
 
 #define AUTH_WR_ADDR_LOW_RST    0x20
 #define AUTH_WR_ADDR_HIGH_RST   0x22
 
-#define I2C_MASTER_NUM              I2C_NUM_0
-#define I2C_MASTER_FREQ_HZ          CONFIG_HAP_IC2_SPEED
-#define I2C_MASTER_RX_BUF_DISABLE   0
-#define I2C_MASTER_TX_BUF_DISABLE   0
-#define ACK_CHECK_EN                1
-#define ACK_VAL                     0
-#define NACK_VAL                    1
-
-/* To use GPIOs 17/18 for the Hardware I2C, replace the numbers 26/27 below
- */
-#define I2C_MASTER_SDA_GPIO         CONFIG_HAP_I2C_SDA_GPIO
-#define I2C_MASTER_SCL_GPIO         CONFIG_HAP_I2C_SCL_GPIO
-
 #define I2C_MASTER_MAX_READ         CONFIG_HAP_I2C_MAX_READ_COUNT
 #define I2C_MASTER_RETRY_TIMES      500
-#define I2C_MASTER_TICKS_TIMES      2 * I2C_MASTER_RETRY_TIMES
 #define I2C_MASTER_MAX_RETRY        10
 #define I2C_MASTER_INTERNAL_TIMES   8 * I2C_MASTER_RETRY_TIMES
+
 /**
- * @brief Initialize I2C information
+ * Coprocessor registers whose contents never change.
+ *
+ * The certificate alone spans up to ten 128-byte registers that are read during every pair setup.
  */
-static int esp_mfi_i2c_init(void)
-{
-    int ret = 0;
-    i2c_config_t conf;
-    int i2c_master_port = I2C_MASTER_NUM;
-
-    conf.mode = I2C_MODE_MASTER;
-    conf.sda_io_num = I2C_MASTER_SDA_GPIO;
-    conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.scl_io_num = I2C_MASTER_SCL_GPIO;
-    conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.master.clk_speed = I2C_MASTER_FREQ_HZ;
-
-    ret = i2c_param_config(i2c_master_port, &conf);
-    if (ret != ESP_OK) {
-        HAPLogError(&logObject, "I2C parameter initial fail %d", ret);
-        return ESP_FAIL;
-    }
+static const struct {
+    uint8_t registerAddress;
+    uint8_t maxBytes;
+    uint16_t offset;
+} staticRegisters[] = {
+    { 0x00, 1, 0 },         // Device Version.
+    { 0x01, 1, 1 },         // Authentication Revision.
+    { 0x02, 1, 2 },         // Authentication Protocol Major Version.
+    { 0x03, 1, 3 },         // Authentication Protocol Minor Version.
+    { 0x04, 4, 4 },         // Device ID.
+    { 0x30, 2, 8 },         // Accessory Certificate Data Length.
+    { 0x31, 128, 10 },      // Accessory Certificate Data 1.
+    { 0x32, 128, 138 },     // Accessory Certificate Data 2.
+    { 0x33, 128, 266 },     // Accessory Certificate Data 3.
+    { 0x34, 128, 394 },     // Accessory Certificate Data 4.
+    { 0x35, 128, 522 },     // Accessory Certificate Data 5.
+    { 0x36, 128, 650 },     // Accessory Certificate Data 6.
+    { 0x37, 128, 778 },     // Accessory Certificate Data 7.
+    { 0x38, 128, 906 },     // Accessory Certificate Data 8.
+    { 0x39, 128, 1034 },    // Accessory Certificate Data 9.
+    { 0x3A, 128, 1162 },    // Accessory Certificate Data 10.
+};
+HAP_STATIC_ASSERT(HAPArrayCount(staticRegisters) == kHAPPlatformMFiHWAuth_NumStaticRegisters, staticRegisters);
+HAP_STATIC_ASSERT(1162 + 128 == kHAPPlatformMFiHWAuth_NumStaticRegisterBytes, staticRegisterBytes);
 
-    ret = i2c_driver_install(i2c_master_port, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
-    if (ret != ESP_OK) {
-        HAPLogError(&logObject, "I2C driver initial fail %d", ret);
-        return ESP_FAIL;
-    }
+/**
+ * Looks up a static coprocessor register.
+ *
+ * @param      registerAddress      Register address.
+ * @param[out] index                Index into staticRegisters, if found.
+ *
+ * @return true                     If the register contents never change.
+ * @return false                    Otherwise.
+ */
+HAP_RESULT_USE_CHECK
+static bool GetStaticRegister(uint8_t registerAddress, size_t* index) {
+    HAPPrecondition(index);
 
-    return 0;
+    for (size_t i = 0; i < HAPArrayCount(staticRegisters); i++) {
+        if (staticRegisters[i].registerAddress == registerAddress) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
 }
+
 /**
  * @brief write data buffer to slave
+ *
+ * Settle times of the coprocessor are served as start delays by the I2C bus, which times them to the microsecond
+ * without blocking the bus or spinning.
+ *
+ * @param      startDelay           Time the coprocessor needs to settle before this transaction, in microseconds.
  */
-static int esp_mfi_i2c_write(uint8_t slvaddr, const uint8_t *buff, uint32_t len)
+static HAPError esp_mfi_i2c_write(uint8_t slvaddr, uint32_t startDelay, const uint8_t *buff, uint32_t len)
 {
-    uint16_t i;
-
-    if (!buff)
-        return ESP_FAIL;
-
-    HAPLog(&logObject, "Writing to HW I2C");
-
-    int ret = 0;
-    i2c_cmd_handle_t cmd = NULL;
-    i = 0;
-
-    do {
-        cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-
-        // Send write address of the CP
-        i2c_master_write_byte(cmd, slvaddr, ACK_CHECK_EN);
-        // Send data out.
-        i2c_master_write(cmd, (uint8_t *)buff, len, ACK_CHECK_EN);
-
-        i2c_master_stop(cmd);
-        ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, I2C_MASTER_TICKS_TIMES / portTICK_RATE_MS);
-        i ++;
-        i2c_cmd_link_delete(cmd);
-        ets_delay_us(I2C_MASTER_RETRY_TIMES);
-    } while(ret != ESP_OK && i < I2C_MASTER_MAX_RETRY);
-
-    if (ret != ESP_OK) {
-        HAPLogError(&logObject, "Write data to slave fail %d.", ret);
+    HAPLogDebug(&logObject, "Writing to HW I2C");
+
+    HAPPlatformI2CBusTransaction transaction = {
+        .address = slvaddr >> 1,
+        .priority = kHAPPlatformI2CBusPriority_High,
+        .maxAttempts = I2C_MASTER_MAX_RETRY,
+        .retryDelay = I2C_MASTER_RETRY_TIMES,
+        .startDelay = startDelay,
+        .writeBytes = buff,
+        .numWriteBytes = len
+    };
+    HAPError err = HAPPlatformI2CBusPerform(&transaction);
+    if (err) {
+        HAPLogError(&logObject, "Write data to slave fail %d.", err);
+        return err;
     }
-    return ret;
+    return kHAPError_None;
 }
 
 /**
  * @brief read data form slave
+ *
+ * The register address is sent in a separate transaction. The coprocessor NACKs it until the previous operation
+ * (e.g. signature generation) has finished, so it is retried by the bus without blocking other devices.
+ *
+ * @param      startDelay           Time the coprocessor needs to settle before this transaction, in microseconds.
  */
-static int esp_mfi_i2c_read(uint8_t slvaddr, uint8_t regaddr, uint8_t *buff, uint32_t len)
+static HAPError esp_mfi_i2c_read(uint8_t slvaddr, uint32_t startDelay, uint8_t regaddr, uint8_t *buff, uint32_t len)
 {
-    uint16_t i, j = 0;
-
-    if (!buff)
-        return ESP_FAIL;
-
-    HAPLog(&logObject, "Reading from HW I2C");
-
-    int ret = 0;
-    i2c_cmd_handle_t cmd = NULL;
-    i = 0;
-
-    do {
-        for (j = 0; j < I2C_MASTER_MAX_READ; j++) {
-            cmd = i2c_cmd_link_create();
-            i2c_master_start(cmd);
-
-            // Send write address of the CP
-            i2c_master_write_byte(cmd, slvaddr, ACK_CHECK_EN);
-            // Send register address to slave.
-            i2c_master_write_byte(cmd, regaddr, ACK_CHECK_EN);
-
-            i2c_master_stop(cmd);
-            ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, I2C_MASTER_TICKS_TIMES / portTICK_RATE_MS);
-            i2c_cmd_link_delete(cmd);
-            if (ret == ESP_OK) {
-                break;
-            } else {
-                ets_delay_us(I2C_MASTER_INTERNAL_TIMES);
-            }
-        }
-
-        ets_delay_us(I2C_MASTER_INTERNAL_TIMES);
-
-        cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-
-        i2c_master_write_byte(cmd, slvaddr + 1, ACK_CHECK_EN);
-        if (len == 1)
-            i2c_master_read_byte(cmd, buff, NACK_VAL);
-        else {
-            i2c_master_read(cmd, buff, len - 1, ACK_VAL);
-            i2c_master_read_byte(cmd, buff + len - 1, NACK_VAL);
+    HAPLogDebug(&logObject, "Reading from HW I2C");
+
+    HAPError err = kHAPError_None;
+    for (int i = 0; i < I2C_MASTER_MAX_RETRY; i++) {
+        HAPPlatformI2CBusTransaction transaction = {
+            .address = slvaddr >> 1,
+            .priority = kHAPPlatformI2CBusPriority_High,
+            .maxAttempts = I2C_MASTER_MAX_READ,
+            .retryDelay = I2C_MASTER_INTERNAL_TIMES,
+            .startDelay = i ? 0 : startDelay,
+            .writeBytes = &regaddr,
+            .numWriteBytes = sizeof regaddr
+        };
+        (void) HAPPlatformI2CBusPerform(&transaction);
+
+        transaction = (HAPPlatformI2CBusTransaction) {
+            .address = slvaddr >> 1,
+            .priority = kHAPPlatformI2CBusPriority_High,
+            .startDelay = I2C_MASTER_INTERNAL_TIMES,
+            .readBytes = buff,
+            .numReadBytes = len
+        };
+        err = HAPPlatformI2CBusPerform(&transaction);
+        if (!err) {
+            break;
         }
-
-        i2c_master_stop(cmd);
-        ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, I2C_MASTER_TICKS_TIMES / portTICK_RATE_MS);
-        i ++;
-        i2c_cmd_link_delete(cmd);
-    } while (ret != ESP_OK && i < I2C_MASTER_MAX_RETRY);
-
-    if (ret != ESP_OK) {
-        HAPLogError(&logObject, "Read data from slave fail %d.", ret);
     }
 
-    return ret;
+    if (err) {
+        HAPLogError(&logObject, "Read data from slave fail %d.", err);
+    }
+    return err;
 }
+
 void HAPPlatformMFiHWAuthCreate(HAPPlatformMFiHWAuthRef mfiHWAuth) {
     HAPPrecondition(mfiHWAuth);
 
-    int ret = 0;
-
-    ret = esp_mfi_i2c_init();
-    if (ret != ESP_OK)
-        HAPFatalError();
-
+    // The I2C bus must have been created.
+    HAPRawBufferZero(mfiHWAuth, sizeof *mfiHWAuth);
     mfiHWAuth->slaveAddr = AUTH_WR_ADDR_LOW_RST;
 }
 
 void HAPPlatformMFiHWAuthRelease(HAPPlatformMFiHWAuthRef mfiHWAuth) {
     HAPPrecondition(mfiHWAuth);
 
-    mfiHWAuth->slaveAddr = 0;
+    HAPRawBufferZero(mfiHWAuth, sizeof *mfiHWAuth);
 }
 
 HAP_RESULT_USE_CHECK
@@ -205,12 +186,31 @@ HAPError HAPPlatformMFiHWAuthPowerOn(HAPPlatformMFiHWAuthRef mfiHWAuth) {
     HAPPrecondition(mfiHWAuth);
 
     mfiHWAuth->poweredOn = true;
+    mfiHWAuth->powerOnTime = HAPPlatformClockGetCurrentMicroseconds();
+    mfiHWAuth->numTransactions = 0;
+    mfiHWAuth->transactionDuration = 0;
+    mfiHWAuth->numCacheHits = 0;
+    mfiHWAuth->cacheDuration = 0;
+    mfiHWAuth->startDelay = 0;
     return kHAPError_None;
 }
 
 void HAPPlatformMFiHWAuthPowerOff(HAPPlatformMFiHWAuthRef mfiHWAuth) {
     HAPPrecondition(mfiHWAuth);
 
+    if (mfiHWAuth->poweredOn) {
+        // The accessory server powers the coprocessor on for each authentication and off afterwards.
+        HAPLogInfo(
+                &logObject,
+                "Coprocessor session: %lu transactions, %llu ms in transactions, "
+                "%lu reads served from RAM saving ~%llu ms, %llu ms powered on.",
+                (unsigned long) mfiHWAuth->numTransactions,
+                (unsigned long long) (mfiHWAuth->transactionDuration / 1000),
+                (unsigned long) mfiHWAuth->numCacheHits,
+                (unsigned long long) (mfiHWAuth->cacheDuration / 1000),
+                (unsigned long long) ((HAPPlatformClockGetCurrentMicroseconds() - mfiHWAuth->powerOnTime) / 1000));
+        HAPPlatformI2CBusLogStatistics();
+    }
     mfiHWAuth->poweredOn = false;
 }
 
@@ -224,10 +224,19 @@ HAPError HAPPlatformMFiHWAuthWrite(HAPPlatformMFiHWAuthRef mfiHWAuth, const void
         return kHAPError_InvalidState;
     }
 
-    if (esp_mfi_i2c_write(mfiHWAuth->slaveAddr, bytes, numBytes) != ESP_OK) {
+    uint64_t startTime = HAPPlatformClockGetCurrentMicroseconds();
+    HAPError err = esp_mfi_i2c_write(mfiHWAuth->slaveAddr, mfiHWAuth->startDelay, bytes, numBytes);
+    // The coprocessor needs time to process a write before the next transaction.
+    mfiHWAuth->startDelay = I2C_MASTER_RETRY_TIMES;
+    uint64_t duration = HAPPlatformClockGetCurrentMicroseconds() - startTime;
+    mfiHWAuth->numTransactions++;
+    mfiHWAuth->transactionDuration += duration;
+    HAPLogDebug(&logObject, "Write of %zu bytes took %llu us.", numBytes, (unsigned long long) duration);
+    if (err) {
         return kHAPError_Unknown;
     }
-    
+
+
     return kHAPError_None;
 }
 
@@ -245,9 +254,42 @@ HAPError HAPPlatformMFiHWAuthRead(
         return kHAPError_InvalidState;
     }
 
-    if (esp_mfi_i2c_read(mfiHWAuth->slaveAddr, registerAddress, bytes, numBytes) != ESP_OK) {
+    size_t index;
+    bool isStatic = GetStaticRegister(registerAddress, &index);
+    if (isStatic && mfiHWAuth->numStaticRegisterBytes[index] >= numBytes) {
+        HAPRawBufferCopyBytes(
+                bytes, &mfiHWAuth->staticRegisterBytes[staticRegisters[index].offset], numBytes);
+        mfiHWAuth->numCacheHits++;
+        mfiHWAuth->cacheDuration += mfiHWAuth->staticRegisterDurations[index];
+        HAPLogDebug(
+                &logObject, "Read of %zu bytes from register 0x%02X served from RAM.", numBytes, registerAddress);
+        return kHAPError_None;
+    }
+
+    uint64_t startTime = HAPPlatformClockGetCurrentMicroseconds();
+    HAPError err = esp_mfi_i2c_read(mfiHWAuth->slaveAddr, mfiHWAuth->startDelay, registerAddress, bytes, numBytes);
+    mfiHWAuth->startDelay = 0;
+    uint64_t duration = HAPPlatformClockGetCurrentMicroseconds() - startTime;
+    mfiHWAuth->numTransactions++;
+    mfiHWAuth->transactionDuration += duration;
+    HAPLogDebug(
+            &logObject,
+            "Read of %zu bytes from register 0x%02X took %llu us.",
+            numBytes,
+            registerAddress,
+            (unsigned long long) duration);
+    if (err) {
         return kHAPError_Unknown;
     }
 
+    if (isStatic) {
+        // Reads past the end of a register continue into the next one. Only keep what belongs to this register.
+        size_t numCachedBytes = HAPMin(numBytes, (size_t) staticRegisters[index].maxBytes);
+        HAPRawBufferCopyBytes(
+                &mfiHWAuth->staticRegisterBytes[staticRegisters[index].offset], bytes, numCachedBytes);
+        mfiHWAuth->numStaticRegisterBytes[index] = (uint8_t) numCachedBytes;
+        mfiHWAuth->staticRegisterDurations[index] = (uint32_t) HAPMin(duration, (uint64_t) UINT32_MAX);
+    }
+
     return kHAPError_None;
 }
@@ -31,58 +31,98 @@ void HAPPlatformMFiTokenAuthCreate(
     HAPPrecondition(options);
     HAPPrecondition(options->keyValueStore);
 
+    HAPRawBufferZero(mfiTokenAuth, sizeof *mfiTokenAuth);
     mfiTokenAuth->keyValueStore = options->keyValueStore;
 }
 
+/**
+ * Loads the Software Token from the key-value store into RAM, unless this has been done before.
+ *
+ * @param      mfiTokenAuth         Software Token provider.
+ *
+ * @return kHAPError_None           If successful.
+ * @return kHAPError_Unknown        If an I/O error occurred.
+ */
 HAP_RESULT_USE_CHECK
-HAPError HAPPlatformMFiTokenAuthLoad(
-        HAPPlatformMFiTokenAuthRef mfiTokenAuth,
-        bool* valid,
-        HAPPlatformMFiTokenAuthUUID* _Nullable mfiTokenUUID,
-        void* _Nullable mfiTokenBytes,
-        size_t maxMFiTokenBytes,
-        size_t* _Nullable numMFiTokenBytes) {
+static HAPError LoadCache(HAPPlatformMFiTokenAuthRef mfiTokenAuth) {
     HAPPrecondition(mfiTokenAuth);
-    HAPPrecondition(valid);
-    HAPPrecondition((mfiTokenUUID == NULL) == (mfiTokenBytes == NULL));
-    HAPPrecondition(!maxMFiTokenBytes || mfiTokenBytes);
-    HAPPrecondition((mfiTokenBytes == NULL) == (numMFiTokenBytes == NULL));
 
     HAPError err;
 
+    if (mfiTokenAuth->isCached) {
+        return kHAPError_None;
+    }
+
     bool foundMFiTokenUUID;
-    size_t numMFiTokenUUIDBytes = 0;
+    size_t numMFiTokenUUIDBytes;
     err = HAPPlatformKeyValueStoreGet(
             mfiTokenAuth->keyValueStore,
             kSDKKeyValueStoreDomain_Provisioning,
             kSDKKeyValueStoreKey_Provisioning_MFiTokenUUID,
-            mfiTokenUUID,
-            mfiTokenUUID ? sizeof *mfiTokenUUID : 0,
-            mfiTokenUUID ? &numMFiTokenUUIDBytes : NULL,
+            &mfiTokenAuth->mfiTokenUUID,
+            sizeof mfiTokenAuth->mfiTokenUUID,
+            &numMFiTokenUUIDBytes,
             &foundMFiTokenUUID);
     if (err) {
         HAPAssert(err == kHAPError_Unknown);
         return err;
     }
     bool foundMFiToken;
-    size_t numMFiTokenBytes_ = 0;
+    size_t numMFiTokenBytes;
     err = HAPPlatformKeyValueStoreGet(
             mfiTokenAuth->keyValueStore,
             kSDKKeyValueStoreDomain_Provisioning,
             kSDKKeyValueStoreKey_Provisioning_MFiToken,
-            mfiTokenBytes,
-            maxMFiTokenBytes,
-            mfiTokenBytes ? &numMFiTokenBytes_ : NULL,
+            mfiTokenAuth->mfiTokenBytes,
+            sizeof mfiTokenAuth->mfiTokenBytes,
+            &numMFiTokenBytes,
             &foundMFiToken);
     if (err) {
         HAPAssert(err == kHAPError_Unknown);
         return err;
     }
+
+    mfiTokenAuth->foundMFiTokenUUID = foundMFiTokenUUID;
+    mfiTokenAuth->foundMFiToken = foundMFiToken;
+    mfiTokenAuth->numMFiTokenBytes = foundMFiToken ? numMFiTokenBytes : 0;
+    mfiTokenAuth->isCached = true;
+    return kHAPError_None;
+}
+
+HAP_RESULT_USE_CHECK
+HAPError HAPPlatformMFiTokenAuthLoad(
+        HAPPlatformMFiTokenAuthRef mfiTokenAuth,
+        bool* valid,
+        HAPPlatformMFiTokenAuthUUID* _Nullable mfiTokenUUID,
+        void* _Nullable mfiTokenBytes,
+        size_t maxMFiTokenBytes,
+        size_t* _Nullable numMFiTokenBytes) {
+    HAPPrecondition(mfiTokenAuth);
+    HAPPrecondition(valid);
+    HAPPrecondition((mfiTokenUUID == NULL) == (mfiTokenBytes == NULL));
+    HAPPrecondition(!maxMFiTokenBytes || mfiTokenBytes);
+    HAPPrecondition((mfiTokenBytes == NULL) == (numMFiTokenBytes == NULL));
+
+    HAPError err;
+
+    err = LoadCache(mfiTokenAuth);
+    if (err) {
+        HAPAssert(err == kHAPError_Unknown);
+        return err;
+    }
+
+    if (mfiTokenUUID && mfiTokenAuth->foundMFiTokenUUID) {
+        HAPRawBufferCopyBytes(mfiTokenUUID, &mfiTokenAuth->mfiTokenUUID, sizeof *mfiTokenUUID);
+    }
     if (numMFiTokenBytes) {
-        *numMFiTokenBytes = numMFiTokenBytes_;
+        *numMFiTokenBytes = HAPMin(mfiTokenAuth->numMFiTokenBytes, maxMFiTokenBytes);
+        if (*numMFiTokenBytes) {
+            HAPAssert(mfiTokenBytes);
+            HAPRawBufferCopyBytes(HAPNonnullVoid(mfiTokenBytes), mfiTokenAuth->mfiTokenBytes, *numMFiTokenBytes);
+        }
     }
 
-    *valid = foundMFiTokenUUID && foundMFiToken;
+    *valid = mfiTokenAuth->foundMFiTokenUUID && mfiTokenAuth->foundMFiToken;
     if (!*valid) {
         return kHAPError_None;
     }
@@ -123,20 +163,12 @@ HAPError HAPPlatformMFiTokenAuthUpdate(
     HAPError err;
 
     // Try to find old Software Token.
-    bool found;
-    err = HAPPlatformKeyValueStoreGet(
-            mfiTokenAuth->keyValueStore,
-            kSDKKeyValueStoreDomain_Provisioning,
-            kSDKKeyValueStoreKey_Provisioning_MFiToken,
-            NULL,
-            0,
-            NULL,
-            &found);
+    err = LoadCache(mfiTokenAuth);
     if (err) {
         HAPAssert(err == kHAPError_Unknown);
         return err;
     }
-    if (!found) {
+    if (!mfiTokenAuth->foundMFiToken) {
         HAPLogInfo(&logObject, "Trying to update Software Token but no Software Token is present in key-value store.");
         return kHAPError_Unknown;
     }
@@ -150,8 +182,11 @@ HAPError HAPPlatformMFiTokenAuthUpdate(
             numMFiTokenBytes);
     if (err) {
         HAPAssert(err == kHAPError_Unknown);
+        mfiTokenAuth->isCached = false;
         return err;
     }
+    HAPRawBufferCopyBytes(mfiTokenAuth->mfiTokenBytes, mfiTokenBytes, numMFiTokenBytes);
+    mfiTokenAuth->numMFiTokenBytes = numMFiTokenBytes;
 
     return kHAPError_None;
 }
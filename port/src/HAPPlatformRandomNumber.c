@@ -18,10 +18,199 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(ESP_PLATFORM)
+#include <bootloader_random.h>
 #include <esp_system.h>
+#else
+#include <sys/random.h>
+#endif
+
 #include "HAPPlatform.h"
+#include "HAPPlatformClock+Init.h"
+#include "HAPPlatformCrypto+Internal.h"
+#include "HAPPlatformRandomNumber+Init.h"
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "RandomNumber" };
+
+/**
+ * Fast-key-erasure random number generator based on ChaCha20.
+ *
+ * Each refill generates a batch of key stream. The first 32 bytes replace the key, so earlier output cannot be
+ * reconstructed from the state, and the remainder is served to callers and erased as it is handed out.
+ * The key is mixed with fresh entropy from the system at start, and again before serving a request when
+ * kReseedPeriod has passed or kReseedInterval bytes have been served since the last reseed. HAP draws so few random
+ * bytes that the byte limit alone could keep a key for days.
+ *
+ * @see https://blog.cr.yp.to/20170723-random.html
+ */
+/**@{*/
+#define kNumBufferBlocks ((size_t) 12)
+#define kReseedInterval  ((size_t) 64 * 1024)
+#define kReseedPeriod    ((HAPTime) 2 * HAPSecond)
+/**@}*/
+
+static struct {
+    pthread_mutex_t mutex;
+    uint8_t key[kHAPPlatformCryptoChaCha20_KeyBytes];
+    uint8_t buffer[kNumBufferBlocks * kHAPPlatformCryptoChaCha20_BlockBytes];
+    size_t numBufferBytes;
+    size_t numBytesSinceReseed;
+    HAPTime reseedTime;
+    uint8_t previousSeed[kHAPPlatformCryptoChaCha20_KeyBytes];
+    bool isInitialized : 1;
+} drbg = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * Fills a buffer with entropy from the system.
+ */
+static void GetEntropy(uint8_t* bytes, size_t numBytes) {
+#if defined(ESP_PLATFORM)
+    // True random numbers are only produced while the RF subsystem (Wi-Fi or BT) is enabled, or while the bootloader
+    // random source is enabled. The initial seed is drawn with the bootloader random source enabled, and mixing with
+    // the previous key keeps the output unpredictable if RF is off during a reseed.
+    esp_fill_random(bytes, numBytes);
+#else
+    while (numBytes) {
+        ssize_t n = getrandom(bytes, numBytes, 0);
+        if (n < 0) {
+            int _errno = errno;
+            if (_errno == EINTR) {
+                continue;
+            }
+            HAPLogError(&logObject, "getrandom failed: %d.", _errno);
+            HAPFatalError();
+        }
+        bytes += n;
+        numBytes -= (size_t) n;
+    }
+#endif
+}
+
+/**
+ * Known answer test of the ChaCha20 block function.
+ *
+ * @see RFC 7539, Section 2.3.2 Test Vector for the ChaCha20 Block Function
+ */
+static void RunSelfTest(void) {
+    static const uint8_t key[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+                                   0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+                                   0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f };
+    static const uint8_t nonce[] = { 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00 };
+    static const uint8_t expectedBytes[] = { 0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd,
+                                             0x1f, 0xa3, 0x20, 0x71, 0xc4, 0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0,
+                                             0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e, 0xd2,
+                                             0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05,
+                                             0xd9, 0x8b, 0x02, 0xa2, 0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e,
+                                             0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e };
+    uint8_t bytes[kHAPPlatformCryptoChaCha20_BlockBytes];
+    HAPPlatformCryptoChaCha20Blocks(bytes, 1, key, nonce, /* counter: */ 1);
+    if (!HAPRawBufferAreEqual(bytes, expectedBytes, sizeof bytes)) {
+        HAPLogError(&logObject, "ChaCha20 known answer test failed.");
+        HAPFatalError();
+    }
+}
+
+/**
+ * Mixes fresh entropy into the key.
+ */
+static void Reseed(void) {
+    uint8_t seed[kHAPPlatformCryptoChaCha20_KeyBytes];
+    GetEntropy(seed, sizeof seed);
+
+    // Continuous test: A stuck entropy source repeats its output.
+    if (drbg.isInitialized && HAPRawBufferAreEqual(seed, drbg.previousSeed, sizeof seed)) {
+        HAPLogError(&logObject, "Entropy source health test failed (repeated output).");
+        HAPFatalError();
+    }
+    HAPRawBufferCopyBytes(drbg.previousSeed, seed, sizeof seed);
+
+    for (size_t i = 0; i < sizeof drbg.key; i++) {
+        drbg.key[i] ^= seed[i];
+    }
+    HAPRawBufferZero(seed, sizeof seed);
+
+    // Discard buffered output so that nothing generated from the old key is handed out after a reseed.
+    HAPRawBufferZero(drbg.buffer, sizeof drbg.buffer);
+    drbg.numBufferBytes = 0;
+    drbg.numBytesSinceReseed = 0;
+    drbg.reseedTime = HAPPlatformClockGetCurrent();
+}
+
+/**
+ * Generates a new batch of output and replaces the key.
+ */
+static void Refill(void) {
+    static const uint8_t nonce[kHAPPlatformCryptoChaCha20_NonceBytes];
+    HAPPlatformCryptoChaCha20Blocks(drbg.buffer, kNumBufferBlocks, drbg.key, nonce, /* counter: */ 0);
+    HAPRawBufferCopyBytes(drbg.key, drbg.buffer, sizeof drbg.key);
+    HAPRawBufferZero(drbg.buffer, sizeof drbg.key);
+    drbg.numBufferBytes = sizeof drbg.buffer - sizeof drbg.key;
+
+    // Health test: Consecutive output words must differ.
+    const uint8_t* output = &drbg.buffer[sizeof drbg.buffer - drbg.numBufferBytes];
+    if (HAPRawBufferAreEqual(&output[0], &output[16], 16)) {
+        HAPLogError(&logObject, "Random number generator health test failed (repeated output).");
+        HAPFatalError();
+    }
+}
+
+void HAPPlatformRandomNumberCreate(void) {
+    int e = pthread_mutex_lock(&drbg.mutex);
+    HAPAssert(!e);
+    HAPPrecondition(!drbg.isInitialized);
+
+    RunSelfTest();
+#if defined(ESP_PLATFORM)
+    // The bootloader random source uses the SAR ADC. It must be disabled again before RF or the ADC are used.
+    bootloader_random_enable();
+    Reseed();
+    bootloader_random_disable();
+#else
+    Reseed();
+#endif
+    drbg.isInitialized = true;
+    HAPLogInfo(&logObject, "ChaCha20 random number generator initialized.");
+
+    e = pthread_mutex_unlock(&drbg.mutex);
+    HAPAssert(!e);
+}
 
 void HAPPlatformRandomNumberFill(void* bytes, size_t numBytes) {
     HAPPrecondition(bytes);
-    esp_fill_random(bytes, numBytes);
+
+    int e = pthread_mutex_lock(&drbg.mutex);
+    HAPAssert(!e);
+
+    // Output must never come from a seed that was drawn without a true entropy source.
+    HAPPrecondition(drbg.isInitialized);
+
+    if (HAPPlatformClockGetCurrent() - drbg.reseedTime >= kReseedPeriod) {
+        Reseed();
+    }
+
+    uint8_t* outBytes = bytes;
+    while (numBytes) {
+        if (drbg.numBytesSinceReseed >= kReseedInterval) {
+            Reseed();
+        }
+        if (!drbg.numBufferBytes) {
+            Refill();
+        }
+
+        // Output is served from the end of the buffer and erased once handed out.
+        size_t n = numBytes < drbg.numBufferBytes ? numBytes : drbg.numBufferBytes;
+        uint8_t* buffer = &drbg.buffer[sizeof drbg.buffer - drbg.numBufferBytes];
+        HAPRawBufferCopyBytes(outBytes, buffer, n);
+        HAPRawBufferZero(buffer, n);
+        drbg.numBufferBytes -= n;
+        drbg.numBytesSinceReseed += n;
+        outBytes += n;
+        numBytes -= n;
+    }
+
+    e = pthread_mutex_unlock(&drbg.mutex);
+    HAPAssert(!e);
 }
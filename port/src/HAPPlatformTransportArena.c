@@ -0,0 +1,84 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdalign.h>
+
+#include "HAPPlatformTransportArena+Init.h"
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "TransportArena" };
+
+void HAPPlatformTransportArenaCreate(
+        HAPPlatformTransportArena* _Nonnull arena,
+        const HAPPlatformTransportArenaOptions* _Nonnull options) {
+    HAPPrecondition(arena);
+    HAPPrecondition(options);
+    HAPPrecondition(options->bytes);
+
+    HAPRawBufferZero(arena, sizeof *arena);
+    arena->bytes = options->bytes;
+    arena->numBytes = options->numBytes;
+}
+
+HAP_RESULT_USE_CHECK
+void* _Nullable HAPPlatformTransportArenaAllocate(
+        HAPPlatformTransportArena* _Nonnull arena,
+        HAPPlatformTransportArenaUser user,
+        size_t numBytes) {
+    HAPPrecondition(arena);
+    HAPPrecondition(user < HAPArrayCount(arena->numUserBytes));
+
+    uintptr_t address = (uintptr_t) arena->bytes + arena->numUsedBytes;
+    size_t numPaddingBytes = (alignof(max_align_t) - address % alignof(max_align_t)) % alignof(max_align_t);
+    size_t numFreeBytes = arena->numBytes - arena->numUsedBytes;
+    if (numPaddingBytes > numFreeBytes || numBytes > numFreeBytes - numPaddingBytes) {
+        HAPLog(&logObject,
+               "Not enough space to allocate %zu bytes for %s transport (%zu / %zu bytes used).",
+               numBytes,
+               user == kHAPPlatformTransportArenaUser_IP ? "IP" : "BLE",
+               arena->numUsedBytes,
+               arena->numBytes);
+        return NULL;
+    }
+
+    uint8_t* bytes = &arena->bytes[arena->numUsedBytes + numPaddingBytes];
+    arena->numUsedBytes += numPaddingBytes + numBytes;
+    arena->numUserBytes[user] += numPaddingBytes + numBytes;
+    HAPRawBufferZero(bytes, numBytes);
+    return bytes;
+}
+
+HAP_RESULT_USE_CHECK
+size_t HAPPlatformTransportArenaGetNumFreeBytes(const HAPPlatformTransportArena* _Nonnull arena) {
+    HAPPrecondition(arena);
+
+    return arena->numBytes - arena->numUsedBytes;
+}
+
+void HAPPlatformTransportArenaLogUsage(const HAPPlatformTransportArena* _Nonnull arena) {
+    HAPPrecondition(arena);
+
+    HAPLogInfo(
+            &logObject,
+            "Transport memory: IP %zu bytes, BLE %zu bytes, %zu / %zu bytes used.",
+            arena->numUserBytes[kHAPPlatformTransportArenaUser_IP],
+            arena->numUserBytes[kHAPPlatformTransportArenaUser_BLE],
+            arena->numUsedBytes,
+            arena->numBytes);
+}
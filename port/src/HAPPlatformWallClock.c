@@ -0,0 +1,230 @@
+// Copyright (c) 2015-2019 The HomeKit ADK Contributors
+//
+// Licensed under the Apache License, Version 2.0 (the “License”);
+// you may not use this file except in compliance with the License.
+// See [CONTRIBUTORS.md] for the list of HomeKit ADK project authors.
+//
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include <sys/time.h>
+
+#if defined(ESP_PLATFORM)
+#include <esp_sntp.h>
+#include <esp_timer.h>
+#endif
+
+#include "HAPPlatform.h"
+#include "HAPPlatformWallClock+Init.h"
+
+static const HAPLogObject logObject = { .subsystem = kHAPPlatform_LogSubsystem, .category = "WallClock" };
+
+/**
+ * Wall clock changes smaller than this are considered drift corrections and are not reported to observers.
+ */
+#define kHAPPlatformWallClock_MinAdjustment ((int64_t) HAPSecond)
+
+static struct {
+    /** UTC in milliseconds minus monotonic time. */
+    int64_t offset;
+
+    HAPPlatformWallClockObserver* _Nullable observers;
+
+    /** Observer to inform next while observers are being informed. Advanced when that observer is removed. */
+    HAPPlatformWallClockObserver* _Nullable nextObserver;
+
+#if defined(ESP_PLATFORM)
+    /** Defers SNTP notifications from the lwIP thread to the esp_timer task. */
+    esp_timer_handle_t _Nullable sntpTimer;
+#endif
+
+    bool isInitialized : 1;
+    bool isSynchronized : 1;
+} wallClock;
+
+/**
+ * Computes the offset between UTC and the monotonic clock.
+ */
+HAP_RESULT_USE_CHECK
+static int64_t GetCurrentOffset(void) {
+    struct timeval t;
+    int e = gettimeofday(&t, NULL);
+    if (e) {
+        int _errno = errno;
+        HAPAssert(e == -1);
+        HAPLogError(&logObject, "gettimeofday failed: %d.", _errno);
+        HAPFatalError();
+    }
+    int64_t utc = (int64_t) t.tv_sec * 1000 + (int64_t) t.tv_usec / 1000;
+    return utc - (int64_t) HAPPlatformClockGetCurrent();
+}
+
+/**
+ * Checks whether the wall clock has been set, i.e., is not still counting from 1970 since boot.
+ */
+HAP_RESULT_USE_CHECK
+static bool IsPlausibleOffset(int64_t offset) {
+    return offset >= (int64_t) 1577836800 * 1000; // 2020-01-01 00:00:00 UTC.
+}
+
+#if defined(ESP_PLATFORM)
+static void HandleSNTPTimerExpired(void* _Nullable context HAP_UNUSED) {
+    // Called on the esp_timer task.
+    HAPPlatformWallClockHandleTimeChanged();
+}
+
+static void HandleSNTPSynchronization(struct timeval* tv HAP_UNUSED) {
+    // Called on the lwIP thread. Scheduling a run loop callback sends to a loopback socket, which waits for this very
+    // thread, so the notification is handed to the esp_timer task. If the timer is already pending, it covers this
+    // synchronization as well.
+    (void) esp_timer_start_once(wallClock.sntpTimer, 0);
+}
+#endif
+
+void HAPPlatformWallClockCreate(void) {
+    HAPPrecondition(!wallClock.isInitialized);
+
+    HAPRawBufferZero(&wallClock, sizeof wallClock);
+    wallClock.offset = GetCurrentOffset();
+    wallClock.isInitialized = true;
+
+    wallClock.isSynchronized = IsPlausibleOffset(wallClock.offset);
+
+#if defined(ESP_PLATFORM)
+    esp_err_t ret = esp_timer_create(
+            &(const esp_timer_create_args_t) { .callback = HandleSNTPTimerExpired, .name = "wall_clock_sntp" },
+            &wallClock.sntpTimer);
+    if (ret != ESP_OK) {
+        HAPLogError(&logObject, "esp_timer_create failed: %d.", ret);
+        HAPFatalError();
+    }
+    sntp_set_time_sync_notification_cb(HandleSNTPSynchronization);
+#endif
+}
+
+void HAPPlatformWallClockRelease(void) {
+#if defined(ESP_PLATFORM)
+    sntp_set_time_sync_notification_cb(NULL);
+    (void) esp_timer_stop(wallClock.sntpTimer);
+    esp_err_t ret = esp_timer_delete(wallClock.sntpTimer);
+    HAPAssert(ret == ESP_OK);
+#endif
+    HAPRawBufferZero(&wallClock, sizeof wallClock);
+}
+
+HAP_RESULT_USE_CHECK
+bool HAPPlatformWallClockIsSynchronized(void) {
+    HAPPrecondition(wallClock.isInitialized);
+
+    return wallClock.isSynchronized;
+}
+
+HAP_RESULT_USE_CHECK
+int64_t HAPPlatformWallClockGetUTCFromTime(HAPTime time) {
+    HAPPrecondition(wallClock.isInitialized);
+
+    return (int64_t) time + wallClock.offset;
+}
+
+HAP_RESULT_USE_CHECK
+int64_t HAPPlatformWallClockGetCurrent(void) {
+    return HAPPlatformWallClockGetUTCFromTime(HAPPlatformClockGetCurrent());
+}
+
+HAP_RESULT_USE_CHECK
+HAPTime HAPPlatformWallClockGetNextBoundary(HAPTime now, HAPTime period, HAPTime phase) {
+    HAPPrecondition(wallClock.isInitialized);
+    HAPPrecondition(period);
+    HAPPrecondition(phase < period);
+
+    int64_t utc = (int64_t) now + wallClock.offset;
+
+    // Distance from the previous boundary. The remainder is normalized so that times before 1970 work as well.
+    int64_t elapsed = (utc - (int64_t) phase) % (int64_t) period;
+    if (elapsed < 0) {
+        elapsed += (int64_t) period;
+    }
+    return now + (period - (HAPTime) elapsed);
+}
+
+void HAPPlatformWallClockAddObserver(
+        HAPPlatformWallClockObserver* _Nonnull observer,
+        HAPPlatformWallClockObserverCallback _Nonnull callback,
+        void* _Nullable context) {
+    HAPPrecondition(wallClock.isInitialized);
+    HAPPrecondition(observer);
+    HAPPrecondition(callback);
+
+    for (HAPPlatformWallClockObserver* other = wallClock.observers; other; other = other->next) {
+        HAPPrecondition(other != observer);
+    }
+
+    observer->callback = callback;
+    observer->context = context;
+    observer->next = wallClock.observers;
+    wallClock.observers = observer;
+}
+
+void HAPPlatformWallClockRemoveObserver(HAPPlatformWallClockObserver* _Nonnull observer) {
+    HAPPrecondition(wallClock.isInitialized);
+    HAPPrecondition(observer);
+
+    for (HAPPlatformWallClockObserver** link = &wallClock.observers; *link; link = &(*link)->next) {
+        if (*link == observer) {
+            *link = observer->next;
+            if (wallClock.nextObserver == observer) {
+                wallClock.nextObserver = observer->next;
+            }
+            HAPRawBufferZero(observer, sizeof *observer);
+            return;
+        }
+    }
+    HAPLogError(&logObject, "%s: Observer not found.", __func__);
+    HAPFatalError();
+}
+
+static void HandleTimeChangedCallback(void* _Nullable context HAP_UNUSED, size_t contextSize HAP_UNUSED) {
+    if (!wallClock.isInitialized) {
+        return;
+    }
+
+    int64_t offset = GetCurrentOffset();
+    int64_t adjustment = offset - wallClock.offset;
+    wallClock.offset = offset;
+    wallClock.isSynchronized = wallClock.isSynchronized || IsPlausibleOffset(offset);
+    if (adjustment > -kHAPPlatformWallClock_MinAdjustment && adjustment < kHAPPlatformWallClock_MinAdjustment) {
+        return;
+    }
+
+    HAPLogInfo(&logObject, "Wall clock adjusted by %lld ms.", (long long) adjustment);
+
+    // Callbacks may remove any observer, including themselves. Observers added from within a callback are not
+    // informed about this adjustment.
+    HAPPlatformWallClockObserver* observer = wallClock.observers;
+    while (observer) {
+        wallClock.nextObserver = observer->next;
+        observer->callback(observer->context, adjustment);
+        observer = wallClock.nextObserver;
+    }
+    wallClock.nextObserver = NULL;
+}
+
+void HAPPlatformWallClockHandleTimeChanged(void) {
+    HAPError err = HAPPlatformRunLoopScheduleCallback(HandleTimeChangedCallback, NULL, 0);
+    if (err) {
+        HAPAssert(err == kHAPError_OutOfResources || err == kHAPError_Unknown);
+        HAPLogError(&logObject, "Failed to schedule wall clock update: %u.", err);
+    }
+}